@@ -0,0 +1,25 @@
+#pragma once
+
+#include <charconv>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+// Command line helpers shared by the applications
+
+// Upper limit for --threads, every worker has its own transposition table
+constexpr unsigned int max_threads = 256;
+
+// Parses the value of a numeric option, naming the option if it is invalid
+// or out of the range of T
+template <typename T>
+T parse_number(std::string_view option, const std::string &value) {
+  T number{};
+  const auto *end = value.data() + value.size();
+  const auto [last, error] = std::from_chars(value.data(), end, number);
+  if (error != std::errc{} || last != end)
+    throw std::invalid_argument("Invalid value for " + std::string(option) +
+                                ": " + value);
+  return number;
+}
@@ -0,0 +1,161 @@
+#include "mcc/bench.hh"
+#include "mcc/common/helpers.hh"
+#include "mcc/cpu.hh"
+#include "mcc/mcc.hh"
+#include "mcc/stats.hh"
+
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Prevents the compiler from optimising away the computation of `value`
+template <typename T> inline void do_not_optimize(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/* Calls `f` repeatedly for at least 200ms and prints the average time per
+   operation, where each call of `f` performs `ops_per_call` operations. */
+template <typename F>
+void measure(std::string_view name, std::size_t ops_per_call, F &&f) {
+  using clock = std::chrono::steady_clock;
+  constexpr auto min_duration = std::chrono::milliseconds(200);
+
+  f(); // warm up
+
+  std::size_t calls = 0;
+  const auto start = clock::now();
+  auto elapsed = clock::duration::zero();
+  while (elapsed < min_duration) {
+    for (int i = 0; i < 16; ++i)
+      f();
+    calls += 16;
+    elapsed = clock::now() - start;
+  }
+
+  const auto ns = std::chrono::duration<double, std::nano>(elapsed).count();
+  std::cout << std::left << std::setw(24) << name << std::right
+            << std::setw(10) << std::fixed << std::setprecision(2)
+            << ns / static_cast<double>(calls * ops_per_call) << " ns/op\n";
+}
+
+inline void run_micro_benchmarks() {
+  std::vector<mcc::mcc> boards;
+  std::vector<std::vector<mcc::Move>> moves;
+  std::size_t total_moves = 0;
+  for (const auto fen : mcc::bench_positions) {
+    boards.emplace_back(fen);
+    moves.push_back(boards.back().generate_moves());
+    total_moves += moves.back().size();
+  }
+  const auto num_positions = boards.size();
+
+  measure("load_from_fen", num_positions, [&]() {
+    for (std::size_t i = 0; i < num_positions; ++i)
+      do_not_optimize(boards[i].load_from_fen(mcc::bench_positions[i]));
+  });
+
+  measure("generate_moves", num_positions, [&]() {
+    for (const auto &board : boards)
+      do_not_optimize(board.generate_moves().size());
+  });
+
+  measure("make_move+unmake_move", total_moves, [&]() {
+    for (std::size_t i = 0; i < num_positions; ++i) {
+      for (const auto &move : moves[i]) {
+        boards[i].make_move(move);
+        do_not_optimize(boards[i].get_key());
+        boards[i].unmake_move();
+      }
+    }
+  });
+
+  measure("get_piece_at", 64 * num_positions, [&]() {
+    for (const auto &board : boards)
+      for (std::size_t file = 0; file < 8; ++file)
+        for (std::size_t rank = 0; rank < 8; ++rank)
+          do_not_optimize(board.get_piece_at(file, rank));
+  });
+
+  measure("in_check", num_positions, [&]() {
+    for (const auto &board : boards)
+      do_not_optimize(board.in_check());
+  });
+
+  // Look up the squares of all pieces, so the compiler cannot fold the loop
+  std::size_t total_pieces = 0;
+  for (const auto &board : boards)
+    total_pieces += static_cast<std::size_t>(std::popcount(board.get_occupied()));
+
+  measure("knight/king tables", 2 * total_pieces, [&]() {
+    std::uint64_t sum = 0;
+    for (const auto &board : boards) {
+      auto occupied = board.get_occupied();
+      while (occupied) {
+        const auto square = static_cast<std::size_t>(std::countr_zero(occupied));
+        sum ^= mcc::knight_attack_board[square] ^ mcc::king_attack_board[square];
+        occupied &= occupied - 1;
+      }
+    }
+    do_not_optimize(sum);
+  });
+
+  measure("rook/bishop attacks", 128 * num_positions, [&]() {
+    std::uint64_t sum = 0;
+    for (const auto &board : boards) {
+      const auto occupied = board.get_occupied();
+      for (int square = 0; square < 64; ++square)
+        sum ^= mcc::rook_attacks(square, occupied) ^
+               mcc::bishop_attacks(square, occupied);
+    }
+    do_not_optimize(sum);
+  });
+}
+
+inline void run_search_bench(int depth) {
+  mcc::stats::reset();
+  const auto result = mcc::run_bench(depth, {}, &std::cout);
+
+  std::cout << "\nDepth:     " << depth << "\n"
+            << "Nodes:     " << result.nodes << "\n"
+            << "Time (ms): "
+            << static_cast<long>(result.seconds * 1000) << "\n"
+            << "NPS:       " << static_cast<long>(result.nps()) << "\n";
+
+  if constexpr (mcc::stats::enabled)
+    std::cout << "Stats:     " << mcc::stats::to_json(mcc::stats::aggregate())
+              << "\n";
+}
+
+/*
+  Usage:
+    bench [depth]  Search the bench positions to the given depth (default 8)
+                   and print the total node count (the bench signature) and
+                   the speed in nodes per second.
+    bench micro    Run micro-benchmarks of the board primitives.
+  Set MCC_ISA=generic or MCC_ISA=popcnt to benchmark the fallback kernels
+  (the default is the best level the CPU supports, see cpu.hh).
+ */
+int main(int argc, char *argv[]) {
+  const std::string command = argc > 1 ? argv[1] : "";
+  std::cout << "Kernels:   " << mcc::cpu::isa_name(mcc::cpu::get_isa())
+            << "\n";
+
+  if (command == "micro") {
+    run_micro_benchmarks();
+    return 0;
+  }
+
+  const int depth = command.empty() ? 8 : std::atoi(command.c_str());
+  if (depth <= 0) {
+    std::cerr << "Usage: " << argv[0] << " [depth | micro]\n";
+    return 1;
+  }
+  run_search_bench(depth);
+}
@@ -1,15 +1,126 @@
+#include "arguments.hh"
+#include "mcc/batch_analysis.hh"
 
-#include <bitset>
+#include <algorithm>
+#include <exception>
+#include <fstream>
 #include <iostream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 
-#include <mcc/mcc.hh>
+struct Config {
+  bool batch = false;
+  std::string input; // FEN, or the batch file (stdin if empty)
+  std::string book;  // Polyglot book (none if empty)
+  std::string syzygy; // Syzygy tablebase directories (none if empty)
+  mcc::BatchOptions options;
+};
 
+inline Config parse_arguments(int argc, char *argv[]) {
+  Config config;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view argument = argv[i];
+    if (argument == "--batch") {
+      config.batch = true;
+      continue;
+    }
+    if (not argument.starts_with("--")) {
+      config.input = argument;
+      continue;
+    }
+
+    if (i + 1 == argc)
+      throw std::invalid_argument("Missing value for " + std::string(argument));
+    const std::string value = argv[++i];
+    if (argument == "--threads")
+      config.options.threads = parse_number<unsigned int>(argument, value);
+    else if (argument == "--depth")
+      config.options.depth = parse_number<int>(argument, value);
+    else if (argument == "--nodes")
+      config.options.nodes = parse_number<std::size_t>(argument, value);
+    else if (argument == "--hash")
+      config.options.hash_megabytes =
+          parse_number<std::size_t>(argument, value);
+    else if (argument == "--book")
+      config.book = value;
+    else if (argument == "--syzygy")
+      config.syzygy = value;
+    else
+      throw std::invalid_argument("Unknown option " + std::string(argument));
+  }
+
+  if (config.options.threads == 0 || config.options.depth <= 0)
+    throw std::invalid_argument("Threads and depth must be positive");
+  if (config.options.depth >= mcc::MAX_PLY)
+    throw std::invalid_argument("Depth must be below " +
+                                std::to_string(mcc::MAX_PLY));
+  config.options.threads = std::min(config.options.threads, max_threads);
+  return config;
+}
+
+/*
+  Usage:
+    engine [fen] [options]            Analyse a single position (default:
+                                      the start position)
+    engine --batch [file] [options]   Analyse every FEN/EPD line of the file
+                                      (or stdin if no file is given)
+  Options:
+    --threads N  Number of positions analysed in parallel (default: all
+                 cores, at most 256)
+    --depth D    Search depth (default 10, at most 127)
+    --nodes N    Stop the search of a position after N nodes
+    --hash MB    Total size of the transposition tables (default 64)
+    --book FILE  Polyglot book, positions in the book are answered with a
+                 book move instead of being searched
+    --syzygy DIR Directory with Syzygy tablebases (several directories are
+                 separated by ':')
+
+  The results are written to stdout as one JSON object per line, in the
+  order of the input (see batch_analysis.hh).
+ */
 int main(int argc, char *argv[]) {
-  std::string fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
-  if (argc == 2) {
-    fen = argv[1];
+  Config config;
+  std::optional<mcc::polyglot::Book> book;
+  std::optional<mcc::syzygy::Tablebases> tablebases;
+  try {
+    config = parse_arguments(argc, argv);
+    if (not config.book.empty())
+      config.options.book = &book.emplace(config.book);
+    if (not config.syzygy.empty()) {
+      if (tablebases.emplace(config.syzygy).size() == 0)
+        throw std::invalid_argument("No Syzygy tables found in " +
+                                    config.syzygy);
+      config.options.tablebases = &*tablebases;
+    }
+  } catch (const std::exception &error) {
+    std::cerr << error.what() << "\n"
+              << "Usage: " << argv[0]
+              << " [fen | --batch [file]] [--threads N] [--depth D]"
+                 " [--nodes N] [--hash MB] [--book FILE] [--syzygy DIR]\n";
+    return 1;
   }
 
-  mcc::mcc engine{};
-  engine.start_uci();
+  if (not config.batch) {
+    std::istringstream input(
+        config.input.empty()
+            ? "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+            : config.input);
+    mcc::analyse_batch(input, std::cout, config.options);
+    return 0;
+  }
+
+  if (config.input.empty()) {
+    mcc::analyse_batch(std::cin, std::cout, config.options);
+    return 0;
+  }
+
+  std::ifstream input(config.input);
+  if (not input) {
+    std::cerr << "Cannot open file " << config.input << "\n";
+    return 1;
+  }
+  mcc::analyse_batch(input, std::cout, config.options);
 }
@@ -1,48 +1,66 @@
 #include "mcc/mcc.hh"
+#include "mcc/stats.hh"
 
 #include <cstddef>
 #include <iostream>
+#include <string>
+#include <vector>
 
-// inline std::size_t perft(unsigned int depth, mcc::mcc engine) {
-//   if (depth == 0)
-//     return 1;
-
-//   std::size_t nodes = 0;
-
-//   std::cout << "\n";
-//   const auto moves = engine.generate_pseudo_legal();
-//   for (const auto move : moves) {
-//     auto occ_before = engine.m_board.get_occupied();
-//     std::cout << move << "\n";
-//     engine.make_move(move);
-//     auto occ_after = engine.m_board.get_occupied();
-//     std::cout << occ_before - occ_after << "\n";
-//     const auto board_before = engine.m_board;
-//     nodes += perft(depth - 1, engine);
-//     engine.m_board = board_before;
-//   }
-
-//   return nodes;
-// }
-
-// inline void perft_display(unsigned int depth, std::size_t expected) {
-//   mcc::mcc engine;
-//   std::cout << "Computed: " << perft(depth, engine)
-//             << ", expected: " << expected << "\n";
-// }
-
-// int main() {
-//   std::vector<std::size_t> expected = {1,      20,      400,      8902,
-//                                        197281, 4865609, 119060324};
-
-//   unsigned int max_depth = 2;
-//   for (unsigned int depth = 1; depth <= max_depth; ++depth)
-//     perft_display(depth, expected.at(depth));
-// }
+inline std::size_t perft(unsigned int depth, mcc::mcc &engine) {
+  if (depth == 0)
+    return 1;
+
+  const auto moves = engine.generate_moves();
+  if (depth == 1)
+    return moves.size();
+
+  std::size_t nodes = 0;
+  for (const auto &move : moves) {
+    engine.make_move(move);
+    nodes += perft(depth - 1, engine);
+    engine.unmake_move();
+  }
+
+  return nodes;
+}
+
+struct PerftPosition {
+  std::string fen;
+  std::vector<std::size_t> expected;
+};
 
 int main() {
-  mcc::mcc engine("8/8/1q1q1q2/2RRR3/1qRKRq2/2RRR3/1q1q1q2/8 w - - 0 1");
-  std::cout << engine << "\n";
+  // Expected node counts from https://www.chessprogramming.org/Perft_Results
+  const std::vector<PerftPosition> positions = {
+      {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+       {1, 20, 400, 8902, 197281, 4865609}},
+      {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+       {1, 48, 2039, 97862, 4085603}},
+      {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+       {1, 14, 191, 2812, 43238, 674624}},
+      {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+       {1, 6, 264, 9467, 422333}},
+      {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+       {1, 44, 1486, 62379, 2103487}},
+  };
+
+  bool all_passed = true;
+  for (const auto &[fen, expected] : positions) {
+    mcc::mcc engine(fen);
+    std::cout << fen << "\n";
+    mcc::stats::reset();
+    for (unsigned int depth = 1; depth < expected.size(); ++depth) {
+      const auto nodes = perft(depth, engine);
+      const bool passed = nodes == expected.at(depth);
+      all_passed &= passed;
+      std::cout << "  depth " << depth << ": computed " << nodes
+                << ", expected " << expected.at(depth)
+                << (passed ? "" : "  <-- MISMATCH") << "\n";
+    }
+
+    if constexpr (mcc::stats::enabled)
+      std::cout << mcc::stats::to_uci_info(mcc::stats::aggregate()) << "\n";
+  }
 
-  engine.generate_moves();
+  return all_passed ? 0 : 1;
 }
@@ -0,0 +1,203 @@
+#include "arguments.hh"
+#include "mcc/batch_loader.hh"
+#include "mcc/mcc.hh"
+#include "mcc/packed_position.hh"
+#include "mcc/search.hh"
+#include "mcc/selfplay.hh"
+#include "mcc/syzygy.hh"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+struct Config {
+  std::string output;
+  std::string openings;
+  std::string book;
+  std::string syzygy;
+  std::size_t games = 1000;
+  unsigned int threads = std::max(std::thread::hardware_concurrency(), 1U);
+  std::size_t hash_megabytes = 16;
+  std::uint64_t seed = 0;
+  mcc::SelfplayOptions options;
+};
+
+inline Config parse_arguments(int argc, char *argv[]) {
+  if (argc < 2)
+    throw std::invalid_argument("Missing output file");
+
+  Config config;
+  config.output = argv[1];
+  for (int i = 2; i < argc; ++i) {
+    const std::string_view option = argv[i];
+    if (i + 1 == argc)
+      throw std::invalid_argument("Missing value for " + std::string(option));
+    const std::string value = argv[++i];
+
+    if (option == "--games")
+      config.games = parse_number<std::size_t>(option, value);
+    else if (option == "--threads")
+      config.threads = parse_number<unsigned int>(option, value);
+    else if (option == "--depth")
+      config.options.depth = parse_number<int>(option, value);
+    else if (option == "--nodes")
+      config.options.nodes = parse_number<std::size_t>(option, value);
+    else if (option == "--openings")
+      config.openings = value;
+    else if (option == "--book")
+      config.book = value;
+    else if (option == "--syzygy")
+      config.syzygy = value;
+    else if (option == "--random-plies")
+      config.options.random_plies = parse_number<int>(option, value);
+    else if (option == "--hash")
+      config.hash_megabytes = parse_number<std::size_t>(option, value);
+    else if (option == "--seed")
+      config.seed = parse_number<std::uint64_t>(option, value);
+    else
+      throw std::invalid_argument("Unknown option " + std::string(option));
+  }
+
+  if (config.games == 0 || config.threads == 0 ||
+      config.hash_megabytes == 0 || config.options.depth <= 0)
+    throw std::invalid_argument("Games, threads, hash and depth must be "
+                                "positive");
+  if (config.options.depth >= mcc::MAX_PLY)
+    throw std::invalid_argument("Depth must be below " +
+                                std::to_string(mcc::MAX_PLY));
+  if (config.options.random_plies < 0)
+    throw std::invalid_argument("Random plies must not be negative");
+  // No more workers (each with its own table) than games
+  config.threads = static_cast<unsigned int>(
+      std::min<std::size_t>({config.threads, max_threads, config.games}));
+  return config;
+}
+
+/*
+  Usage:
+    selfplay <output> [--games N] [--threads N] [--depth D] [--nodes N]
+             [--openings file.epd] [--book file.bin] [--random-plies N]
+             [--hash MB] [--seed S] [--syzygy DIR]
+
+  Plays N games of the engine against itself on all cores (at most 256
+  threads) and writes the recorded positions with their scores and the game
+  results to <output> in the packed position format (see
+  packed_position.hh). Every move is searched to depth D (at most 127), or
+  until N nodes are searched if --nodes is given (the search then stops at
+  the node limit or depth D, whichever comes first). Each game starts from a
+  random position of the EPD file (or the start position), followed by moves
+  from the Polyglot book (if given) as long as the position is in the book
+  and a number of random moves. Game i only depends on the seed and i, not on
+  the number of threads (only the order of the games in the output does).
+  With --syzygy, the search probes the tablebases in DIR (several
+  directories are separated by ':').
+ */
+int main(int argc, char *argv[]) {
+  Config config;
+  std::vector<mcc::mcc> openings;
+  std::optional<mcc::polyglot::Book> book;
+  std::optional<mcc::syzygy::Tablebases> tablebases;
+  try {
+    config = parse_arguments(argc, argv);
+    if (not config.book.empty())
+      book.emplace(config.book);
+    if (not config.syzygy.empty() &&
+        tablebases.emplace(config.syzygy).size() == 0)
+      throw std::invalid_argument("No Syzygy tables found in " +
+                                  config.syzygy);
+    if (not config.openings.empty())
+      openings = mcc::load_positions(config.openings, config.threads);
+    if (openings.empty())
+      openings.emplace_back();
+  } catch (const std::exception &error) {
+    std::cerr << error.what() << "\n"
+              << "Usage: " << argv[0]
+              << " <output> [--games N] [--threads N] [--depth D] [--nodes N]"
+                 " [--openings file.epd] [--book file.bin] [--random-plies N]"
+                 " [--hash MB] [--seed S] [--syzygy DIR]\n";
+    return 1;
+  }
+
+  mcc::PackedPositionWriter writer(config.output);
+  std::mutex mutex; // Guards the writer and the counters below
+  std::condition_variable finished;
+  std::size_t games_done = 0;
+  std::size_t positions_written = 0;
+  std::array<std::size_t, 3> results = {}; // Black wins, draws, White wins
+  unsigned int threads_done = 0;
+
+  std::atomic<std::size_t> next_game = 0;
+  const auto start = std::chrono::steady_clock::now();
+  {
+    std::vector<std::jthread> workers;
+    for (unsigned int t = 0; t < config.threads; ++t) {
+      workers.emplace_back([&]() {
+        mcc::Searcher searcher({}, config.hash_megabytes);
+        searcher.set_tablebases(tablebases ? &*tablebases : nullptr);
+
+        for (auto game_index = next_game++; game_index < config.games;
+             game_index = next_game++) {
+          std::mt19937_64 generator(config.seed + game_index);
+          std::uniform_int_distribution<std::size_t> pick(0, openings.size() -
+                                                                 1);
+          const auto game =
+              mcc::play_game(openings[pick(generator)], searcher,
+                             config.options, generator,
+                             book ? &*book : nullptr);
+
+          std::lock_guard lock{mutex};
+          for (const auto &position : game.positions)
+            writer.write(position);
+          positions_written += game.positions.size();
+          ++games_done;
+          ++results[static_cast<std::size_t>(
+              static_cast<int>(game.result) + 1)];
+        }
+
+        std::lock_guard lock{mutex};
+        ++threads_done;
+        finished.notify_one();
+      });
+    }
+
+    // Report the progress every few seconds until all games are played
+    std::unique_lock lock{mutex};
+    while (not finished.wait_for(lock, std::chrono::seconds(5), [&]() {
+      return threads_done == config.threads;
+    })) {
+      const std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      std::cout << "Games " << games_done << "/" << config.games
+                << ", positions " << positions_written << ", "
+                << static_cast<long>(static_cast<double>(positions_written) /
+                                     elapsed.count())
+                << " positions/s" << std::endl;
+    }
+  }
+  writer.flush();
+
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cout << "Games:       " << games_done << " (+" << results[2] << " ="
+            << results[1] << " -" << results[0] << ")\n"
+            << "Positions:   " << positions_written << "\n"
+            << "Time (s):    " << elapsed.count() << "\n"
+            << "Positions/s: "
+            << static_cast<long>(static_cast<double>(positions_written) /
+                                 elapsed.count())
+            << "\n";
+}
@@ -0,0 +1,136 @@
+#include "arguments.hh"
+#include "mcc/eval.hh"
+#include "mcc/tuner.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+struct Config {
+  std::string data;
+  std::string output;
+  int epochs = 1000;
+  double learning_rate = 1.0;
+  double k = 0; // Fitted to the data if zero
+  unsigned int threads = std::max(std::thread::hardware_concurrency(), 1U);
+};
+
+inline Config parse_arguments(int argc, char *argv[]) {
+  if (argc < 2)
+    throw std::invalid_argument("Missing data file");
+
+  Config config;
+  config.data = argv[1];
+  for (int i = 2; i < argc; ++i) {
+    const std::string_view option = argv[i];
+    if (i + 1 == argc)
+      throw std::invalid_argument("Missing value for " + std::string(option));
+    const std::string value = argv[++i];
+
+    if (option == "--epochs")
+      config.epochs = parse_number<int>(option, value);
+    else if (option == "--lr")
+      config.learning_rate = parse_number<double>(option, value);
+    else if (option == "--k")
+      config.k = parse_number<double>(option, value);
+    else if (option == "--threads")
+      config.threads = parse_number<unsigned int>(option, value);
+    else if (option == "--output")
+      config.output = value;
+    else
+      throw std::invalid_argument("Unknown option " + std::string(option));
+  }
+
+  if (config.epochs <= 0 || config.threads == 0 ||
+      not std::isfinite(config.learning_rate) || config.learning_rate <= 0)
+    throw std::invalid_argument("Epochs, learning rate and threads must be "
+                                "positive");
+  if (not std::isfinite(config.k) || config.k < 0)
+    throw std::invalid_argument("K must not be negative");
+  config.threads = std::min(config.threads, max_threads);
+  return config;
+}
+
+inline void save(const Config &config, const std::vector<double> &params) {
+  const auto eval_params = mcc::tuner::from_vector(params);
+  if (config.output.empty()) {
+    mcc::tuner::write_params(std::cout, eval_params);
+    return;
+  }
+  std::ofstream out(config.output);
+  mcc::tuner::write_params(out, eval_params);
+}
+
+/*
+  Usage:
+    tune <data> [--epochs N] [--lr X] [--k K] [--threads N] [--output file]
+
+  Tunes the material and piece-square values on the positions in <data>
+  (FEN/EPD lines with results, or packed positions from selfplay with the
+  extension .bin), starting from the current default_eval_params. Prints the
+  loss and the time per epoch, and writes the tuned tables in the format of
+  eval.hh to the output file (every 100 epochs and at the end) or to stdout.
+  The loss is computed on all cores, or on N threads (at most 256). With
+  --k 0 (the default), K is fitted to the data first.
+ */
+int main(int argc, char *argv[]) {
+  Config config;
+  try {
+    config = parse_arguments(argc, argv);
+  } catch (const std::exception &error) {
+    std::cerr << error.what() << "\n"
+              << "Usage: " << argv[0]
+              << " <data> [--epochs N] [--lr X] [--k K] [--threads N]"
+                 " [--output file]\n";
+    return 1;
+  }
+
+  using clock = std::chrono::steady_clock;
+  const auto seconds_since = [](clock::time_point start) {
+    return std::chrono::duration<double>(clock::now() - start).count();
+  };
+
+  auto start = clock::now();
+  const auto data = mcc::tuner::load_dataset(config.data, config.threads);
+  std::cout << "Positions: " << data.size() << " (" << data.skipped
+            << " skipped), loaded in " << seconds_since(start) << " s"
+            << std::endl;
+  if (data.size() == 0)
+    return 1;
+
+  auto params = mcc::tuner::to_vector(mcc::default_eval_params);
+  const double k = config.k > 0
+                       ? config.k
+                       : mcc::tuner::fit_k(data, params, config.threads);
+  std::cout << "K:         " << k << "\n"
+            << "Loss:      " << std::setprecision(8)
+            << mcc::tuner::compute_loss(data, params, k, config.threads)
+            << std::endl;
+
+  mcc::tuner::AdamOptimizer optimizer(config.learning_rate);
+  std::vector<double> gradient;
+  for (int epoch = 1; epoch <= config.epochs; ++epoch) {
+    start = clock::now();
+    const double loss = mcc::tuner::compute_loss(data, params, k,
+                                                 config.threads, &gradient);
+    optimizer.step(params, gradient);
+
+    std::cout << "Epoch " << epoch << ": loss " << loss << ", "
+              << std::setprecision(3) << seconds_since(start) << " s"
+              << std::setprecision(8) << std::endl;
+    if (epoch % 100 == 0 && not config.output.empty())
+      save(config, params);
+  }
+
+  save(config, params);
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include "mcc/mcc.hh"
+#include "mcc/polyglot_book.hh"
+#include "mcc/search.hh"
+#include "mcc/syzygy.hh"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <istream>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace mcc {
+struct BatchOptions {
+  // Total number of threads, every worker searches with one thread
+  unsigned int threads = std::max(std::thread::hardware_concurrency(), 1U);
+  int depth = 10;                   // Search depth per position
+  std::size_t nodes = 0;            // Node limit per position (zero for none)
+  std::size_t hash_megabytes = 64;  // Total, split evenly between the workers
+  // Positions in the book get a book move instead of a search (the book
+  // must outlive the analysis)
+  const polyglot::Book *book = nullptr;
+  // Tablebases probed by the search (must outlive the analysis)
+  const syzygy::Tablebases *tablebases = nullptr;
+};
+
+// Escapes `text` for use in a JSON string
+inline std::string escape_json(std::string_view text) {
+  std::string escaped;
+  escaped.reserve(text.size());
+  for (const char c : text) {
+    if (c == '"' || c == '\\')
+      escaped += '\\';
+    if (static_cast<unsigned char>(c) < 0x20)
+      escaped += ' ';
+    else
+      escaped += c;
+  }
+  return escaped;
+}
+
+/* Formats the result of a search as a single line JSON object, eg.
+     {"fen": "...", "bestmove": "e2e4", "score": {"cp": 25}, "depth": 10,
+      "pv": ["e2e4", "e7e5"], "nodes": 12345, "book": false}
+   Mate scores are given as {"mate": n} with n the number of moves until
+   mate (negative if the side to move gets mated). Tablebase wins and losses
+   are given as {"tb": "win", "plies": n} or {"tb": "loss", "plies": n}, with
+   n the number of plies until the tablebase position is reached. Scores are
+   from the point of view of the side to move.
+
+   Book moves (`book` is true) use the same fields: the score is null, the
+   depth and nodes are 0 and the pv only holds the book move. */
+inline std::string to_json(std::string_view fen, const SearchResult &result,
+                           bool book = false) {
+  std::ostringstream out;
+  out << "{\"fen\": \"" << escape_json(fen) << "\", \"bestmove\": ";
+  if (result.pv.empty())
+    out << "null";
+  else
+    out << "\"" << result.pv.front().to_uci() << "\"";
+
+  out << ", \"score\": ";
+  if (book)
+    out << "null";
+  else if (result.score >= MATE_BOUND)
+    out << "{\"mate\": " << (MATE_SCORE - result.score + 1) / 2 << "}";
+  else if (result.score <= -MATE_BOUND)
+    out << "{\"mate\": " << -(MATE_SCORE + result.score) / 2 << "}";
+  else if (result.score >= TB_WIN_BOUND)
+    out << "{\"tb\": \"win\", \"plies\": " << TB_WIN_SCORE - result.score
+        << "}";
+  else if (result.score <= -TB_WIN_BOUND)
+    out << "{\"tb\": \"loss\", \"plies\": " << TB_WIN_SCORE + result.score
+        << "}";
+  else
+    out << "{\"cp\": " << result.score << "}";
+  out << ", \"depth\": " << result.depth << ", \"pv\": [";
+  for (std::size_t i = 0; i < result.pv.size(); ++i)
+    out << (i > 0 ? ", " : "") << "\"" << result.pv[i].to_uci() << "\"";
+  out << "], \"nodes\": " << result.nodes
+      << ", \"book\": " << (book ? "true" : "false") << "}";
+  return out.str();
+}
+
+// Number of positions that may be analysed ahead of the next result to
+// write, which bounds the results held back by analyse_batch()
+inline std::size_t batch_window(unsigned int workers) {
+  return 4 * std::size_t{workers};
+}
+
+/* Analyses every position (one FEN or EPD per line, empty lines are skipped)
+   read from `in` and writes one JSON line per position to `out`, see
+   to_json(). Invalid positions give {"fen": "...", "error": "..."}. If a
+   book is given, positions in the book are not searched and give a book
+   result (see to_json()), with the move picked at random (seeded with the
+   index of the position) according to the book weights.
+
+   The positions are searched by a pool of options.threads workers, each with
+   its own board and searcher (and thus transposition table). Workers read
+   the next line from `in` when they are done with a position, so the input
+   is streamed and can be arbitrarily long. Results are written in input
+   order: a finished result is held back until all results before it have
+   been written. A worker does not start a position more than
+   batch_window(workers) positions ahead of the next result to write, so a
+   slow position only holds back a bounded number of results. The
+   transposition table is cleared before every position (which only starts a
+   new generation of the table, see TranspositionTable), so each result only
+   depends on the position and the options, not on the number of workers or
+   the order in which they pick up positions.
+
+   Returns the number of positions analysed. */
+inline std::size_t analyse_batch(std::istream &in, std::ostream &out,
+                                 const BatchOptions &options) {
+  const auto workers = std::max(options.threads, 1U);
+  const auto hash_megabytes =
+      std::max<std::size_t>(options.hash_megabytes / workers, 1);
+
+  std::mutex input_mutex; // Guards `in` and next_input
+  std::size_t next_input = 0;
+
+  std::mutex output_mutex; // Guards `out`, next_output and finished
+  std::condition_variable output_written;
+  std::size_t next_output = 0;
+  std::map<std::size_t, std::string> finished;
+  const auto window = batch_window(workers);
+
+  // Reads the next non-empty line, returns false at the end of the input
+  const auto next_job = [&](std::string &line, std::size_t &index) {
+    std::lock_guard lock{input_mutex};
+    while (std::getline(in, line)) {
+      if (not line.empty() && line.back() == '\r')
+        line.pop_back();
+      if (line.find_first_not_of(" \t") != std::string::npos) {
+        index = next_input++;
+        return true;
+      }
+    }
+    return false;
+  };
+
+  // Waits until the position with the given index is within the window.
+  // The position at next_output is always being analysed by a worker that
+  // does not wait, so this cannot deadlock
+  const auto wait_for_window = [&](std::size_t index) {
+    std::unique_lock lock{output_mutex};
+    output_written.wait(lock, [&]() { return index < next_output + window; });
+  };
+
+  const auto write_result = [&](std::size_t index, std::string json) {
+    {
+      std::lock_guard lock{output_mutex};
+      finished.emplace(index, std::move(json));
+      while (not finished.empty() && finished.begin()->first == next_output) {
+        out << finished.begin()->second << '\n';
+        finished.erase(finished.begin());
+        ++next_output;
+      }
+      out.flush();
+    }
+    output_written.notify_all();
+  };
+
+  {
+    std::vector<std::jthread> threads;
+    for (unsigned int t = 0; t < workers; ++t) {
+      threads.emplace_back([&]() {
+        mcc board;
+        Searcher searcher({}, hash_megabytes);
+        searcher.set_tablebases(options.tablebases);
+
+        std::string line;
+        std::size_t index = 0;
+        while (next_job(line, index)) {
+          wait_for_window(index);
+          if (not board.load_from_fen(line)) {
+            write_result(index, "{\"fen\": \"" + escape_json(line) +
+                                    "\", \"error\": \"invalid position\"}");
+            continue;
+          }
+
+          if (options.book) {
+            std::mt19937_64 generator(index);
+            if (const auto move = options.book->pick(board, generator)) {
+              SearchResult book_result;
+              book_result.pv = {*move};
+              write_result(index, to_json(line, book_result, true));
+              continue;
+            }
+          }
+
+          searcher.clear();
+          const auto result =
+              searcher.search(board, options.depth, options.nodes);
+          write_result(index, to_json(line, result));
+        }
+      });
+    }
+  }
+
+  return next_input;
+}
+} // namespace mcc
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "mcc/mapped_file.hh"
+#include "mcc/mcc.hh"
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace mcc {
+/* Calls `f` for every non-empty line in `text` (line endings are stripped).
+   `f` is called with the line and its (0-indexed) line number within `text`.
+ */
+template <typename F> void for_each_line(std::string_view text, F &&f) {
+  std::size_t line_number = 0;
+  while (not text.empty()) {
+    const auto end = text.find('\n');
+    auto line = text.substr(0, end);
+    text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+
+    if (not line.empty() && line.back() == '\r')
+      line.remove_suffix(1);
+    if (line.find_first_not_of(" \t") != std::string_view::npos)
+      f(line, line_number);
+    ++line_number;
+  }
+}
+
+/* Splits `text` into at most `parts` chunks of roughly equal size such that
+   every chunk consists of complete lines. */
+inline std::vector<std::string_view> split_into_line_chunks(std::string_view text,
+                                                            std::size_t parts) {
+  std::vector<std::string_view> chunks;
+  const auto chunk_size = text.size() / std::max<std::size_t>(parts, 1) + 1;
+
+  while (not text.empty()) {
+    auto end = text.find('\n', std::min(chunk_size, text.size()) - 1);
+    end = (end == std::string_view::npos) ? text.size() : end + 1;
+    chunks.push_back(text.substr(0, end));
+    text.remove_prefix(end);
+  }
+  return chunks;
+}
+
+/* Loads all positions from a FEN or EPD file with one position per line into
+   an array, in the order they appear in the file. Empty lines are skipped.
+   The file is memory-mapped and split into chunks which are parsed by
+   `num_threads` threads in parallel. Throws a std::runtime_error if the file
+   cannot be read or contains an invalid position.
+ */
+inline std::vector<mcc>
+load_positions(const std::filesystem::path &path,
+               unsigned int num_threads = std::thread::hardware_concurrency()) {
+  const MappedFile file(path);
+  file.advise_sequential();
+
+  const auto chunks =
+      split_into_line_chunks(file.view(), std::max(num_threads, 1U));
+
+  // Pass 1: Count the positions (and lines) in each chunk, so that every
+  // thread knows where to put its positions in the result.
+  std::vector<std::size_t> first_position(chunks.size() + 1, 0);
+  std::vector<std::size_t> first_line(chunks.size() + 1, 0);
+  {
+    std::vector<std::jthread> threads;
+    for (std::size_t i = 0; i < chunks.size(); ++i) {
+      threads.emplace_back([&, i]() {
+        std::size_t positions = 0;
+        for_each_line(chunks[i], [&](std::string_view, std::size_t) {
+          ++positions;
+        });
+        first_position[i + 1] = positions;
+        first_line[i + 1] = static_cast<std::size_t>(
+            std::count(chunks[i].begin(), chunks[i].end(), '\n'));
+      });
+    }
+  }
+  for (std::size_t i = 1; i <= chunks.size(); ++i) {
+    first_position[i] += first_position[i - 1];
+    first_line[i] += first_line[i - 1];
+  }
+
+  // Pass 2: Parse the positions in place
+  std::vector<mcc> positions(first_position.back(), mcc{});
+  constexpr auto no_error = std::string_view::npos;
+  std::vector<std::size_t> first_invalid_line(chunks.size(), no_error);
+  {
+    std::vector<std::jthread> threads;
+    for (std::size_t i = 0; i < chunks.size(); ++i) {
+      threads.emplace_back([&, i]() {
+        auto position = first_position[i];
+        for_each_line(chunks[i], [&](std::string_view line,
+                                     std::size_t line_number) {
+          if (not positions[position++].load_from_fen(line) &&
+              first_invalid_line[i] == no_error)
+            first_invalid_line[i] = first_line[i] + line_number;
+        });
+      });
+    }
+  }
+
+  for (auto line : first_invalid_line) {
+    if (line != no_error)
+      throw std::runtime_error("[mcc::load_positions] Invalid position in line " +
+                               std::to_string(line + 1) + " of " +
+                               path.string());
+  }
+
+  return positions;
+}
+} // namespace mcc
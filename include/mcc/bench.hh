@@ -0,0 +1,62 @@
+#pragma once
+
+#include "mcc/mcc.hh"
+#include "mcc/search.hh"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string_view>
+
+namespace mcc {
+// Positions searched by the bench command
+constexpr inline std::array<std::string_view, 12> bench_positions = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+    "r2q1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP3PPP/R2QKB1R w KQ - 0 9",
+    "2r3k1/pp3ppp/4p3/3p4/3P4/4P3/PP3PPP/2R3K1 w - - 0 25",
+    "8/8/4k3/3p4/3P4/4K3/8/8 w - - 0 50",
+    "8/5pk1/6p1/8/8/6P1/5PK1/3R4 w - - 0 40",
+    "6k1/5ppp/8/8/8/8/q4PPP/1R4K1 b - - 0 30",
+};
+
+struct BenchResult {
+  std::size_t nodes = 0;
+  double seconds = 0;
+
+  double nps() const {
+    return seconds > 0 ? static_cast<double>(nodes) / seconds : 0;
+  }
+};
+
+/* Searches all bench positions to the given depth with a fresh searcher each
+   (so the result does not depend on the order of the positions) and returns
+   the total number of nodes. The node count serves as a signature: it only
+   changes if the search or the move generation changes. */
+inline BenchResult run_bench(int depth, SearchOptions options = {},
+                             std::ostream *log = nullptr) {
+  BenchResult result;
+
+  const auto start = std::chrono::steady_clock::now();
+  for (const auto fen : bench_positions) {
+    mcc board(fen);
+    Searcher searcher(options);
+    const auto search_result = searcher.search(board, depth);
+    result.nodes += search_result.nodes;
+
+    if (log)
+      *log << fen << ": " << search_result.nodes << " nodes, score "
+           << search_result.score << "\n";
+  }
+  const auto end = std::chrono::steady_clock::now();
+
+  result.seconds = std::chrono::duration<double>(end - start).count();
+  return result;
+}
+} // namespace mcc
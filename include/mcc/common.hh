@@ -1,7 +1,10 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
+#include <cstdlib>
 #include <string>
+#include <string_view>
 
 namespace mcc {
 
@@ -9,8 +12,7 @@ inline std::string from_64_to_algebraic(std::uint8_t field) {
   const auto file = field % 8;
   const auto rank = 8 - field / 8;
 
-  const char file_as_char = 'a' + file;
-  return std::string(1, file_as_char) + std::to_string(rank);
+  return {static_cast<char>('a' + file), static_cast<char>('0' + rank)};
 }
 
 /* Convert from file and rank to number within 64 field bitboard.
@@ -29,7 +31,7 @@ inline int from_algebraic_to_64(std::string_view algebraic) {
   return from_algebraic_to_64(file, rank);
 }
 
-inline bool is_inside_chessboard(int num) { return (num >= 0) && (num <= 63); }
+constexpr bool is_inside_chessboard(int num) { return (num >= 0) && (num <= 63); }
 
 inline void set_bit(std::uint64_t *val, std::uint8_t position) {
   *val |= (1UL << position);
@@ -1,14 +1,20 @@
 #pragma once
 
-#include "mcc/common/helpers.hh"
+#include "mcc/common.hh"
 #include "mcc/common/colour.hh"
 #include "mcc/common/piece.hh"
-#include "mcc/helpers.hh"
+#include "mcc/cpu.hh"
 
 #include <array>
-#include <bits/utility.h>
+#include <bit>
+#include <cstddef>
 #include <cstdint>
 #include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 namespace mcc {
 using lookup_table = std::array<uint64_t, 64>;
@@ -109,17 +115,6 @@ constexpr inline lookup_table king_attack_board = []() {
   return lut;
 }();
 
-namespace Direction {
-static constexpr int North = -8;
-static constexpr int East = 1;
-static constexpr int West = -1;
-static constexpr int South = 8;
-static constexpr int NorthWest = -9;
-static constexpr int NorthEast = -7;
-static constexpr int SouthWest = 7;
-static constexpr int SouthEast = 9;
-} // namespace Direction
-
 template <int... directions>
 constexpr auto attack_board_sliding = []() {
   lookup_table lut = {};
@@ -145,4 +140,141 @@ constexpr auto attack_board_sliding = []() {
   }
   return lut;
 }();
+constexpr inline uint64_t file_a = 0x0101010101010101UL;
+constexpr inline uint64_t file_h = file_a << 7;
+
+// Returns all squares attacked by the pawns of the given colour in `pawns`.
+template <Colour colour> constexpr uint64_t pawn_attacks(uint64_t pawns) {
+  if constexpr (colour == Colour::White)
+    return ((pawns & ~file_a) >> 9) | ((pawns & ~file_h) >> 7);
+  else
+    return ((pawns & ~file_a) << 7) | ((pawns & ~file_h) << 9);
+}
+
+inline uint64_t pawn_attacks(Colour colour, uint64_t pawns) {
+  return colour == Colour::White ? pawn_attacks<Colour::White>(pawns)
+                                 : pawn_attacks<Colour::Black>(pawns);
+}
+
+/* Computes the attacks of a sliding piece on `square` along the given
+   directions. Each ray stops at (and includes) the first occupied square. */
+template <int... directions>
+constexpr uint64_t sliding_attacks(int square, uint64_t occupied) {
+  uint64_t attacks = 0;
+  (
+      [&] {
+        int from = square;
+        int to = square + directions;
+        while (to >= 0 and to <= 63 and distance(from, to) == 1) {
+          attacks |= 1UL << to;
+          if (occupied & (1UL << to))
+            break;
+          from = to;
+          to += directions;
+        }
+      }(),
+      ...);
+  return attacks;
+}
+
+constexpr uint64_t rook_attacks_generic(int square, uint64_t occupied) {
+  return sliding_attacks<-8, 8, -1, 1>(square, occupied);
+}
+
+constexpr uint64_t bishop_attacks_generic(int square, uint64_t occupied) {
+  return sliding_attacks<-9, -7, 7, 9>(square, occupied);
+}
+
+/*
+  Slider attack tables indexed with PEXT. For every square, the relevant
+  occupancy mask contains the squares on the rays of the piece without the
+  board edges (a piece on the edge never blocks anything further out).
+  Extracting the occupied bits under the mask gives a dense index into the
+  attacks of that square:
+    attacks[offsets[square] + pext(occupied, masks[square])]
+  The tables are only built if the CPU supports fast PEXT (see cpu.hh), all
+  other CPUs use the generic loops above.
+ */
+struct SliderTable {
+  lookup_table masks = {};
+  std::array<std::size_t, 64> offsets = {};
+  std::vector<uint64_t> attacks;
+};
+
+// Software version of PDEP: scatters the low bits of `bits` to the set bits
+// of `mask`
+constexpr uint64_t deposit_bits(uint64_t bits, uint64_t mask) {
+  uint64_t result = 0;
+  for (uint64_t bit = 1; mask; bit <<= 1) {
+    if (bits & bit)
+      result |= mask & -mask;
+    mask &= mask - 1;
+  }
+  return result;
+}
+
+template <int... directions> inline SliderTable make_slider_table() {
+  constexpr uint64_t rank_8 = 0xFFUL;
+  constexpr uint64_t rank_1 = rank_8 << 56;
+
+  SliderTable table;
+  for (int square = 0; square < 64; ++square) {
+    const auto sq = static_cast<std::size_t>(square);
+    const uint64_t rank = rank_8 << (square & ~7);
+    const uint64_t file = file_a << (square & 7);
+    const uint64_t edges =
+        ((rank_1 | rank_8) & ~rank) | ((file_a | file_h) & ~file);
+
+    table.masks[sq] = sliding_attacks<directions...>(square, 0) & ~edges;
+    table.offsets[sq] = table.attacks.size();
+
+    const auto subsets = std::size_t{1} << std::popcount(table.masks[sq]);
+    for (std::size_t index = 0; index < subsets; ++index)
+      table.attacks.push_back(sliding_attacks<directions...>(
+          square, deposit_bits(index, table.masks[sq])));
+  }
+  return table;
+}
+
+struct SliderTables {
+  bool use_pext = false;
+  SliderTable rook;
+  SliderTable bishop;
+};
+
+/* Built once at startup. Until then (ie. during static initialisation of
+   other globals) use_pext is false and the generic loops are used. */
+inline const SliderTables slider_tables = []() {
+  SliderTables tables;
+  if (cpu::get_isa() >= cpu::Isa::Bmi2) {
+    tables.rook = make_slider_table<-8, 8, -1, 1>();
+    tables.bishop = make_slider_table<-9, -7, 7, 9>();
+    tables.use_pext = true;
+  }
+  return tables;
+}();
+
+#if defined(__x86_64__)
+__attribute__((target("bmi2"))) inline uint64_t
+slider_attacks_pext(const SliderTable &table, int square, uint64_t occupied) {
+  const auto sq = static_cast<std::size_t>(square);
+  return table.attacks[table.offsets[sq] + _pext_u64(occupied, table.masks[sq])];
+}
+#endif
+
+inline uint64_t rook_attacks(int square, uint64_t occupied) {
+#if defined(__x86_64__)
+  if (slider_tables.use_pext)
+    return slider_attacks_pext(slider_tables.rook, square, occupied);
+#endif
+  return rook_attacks_generic(square, occupied);
+}
+
+inline uint64_t bishop_attacks(int square, uint64_t occupied) {
+#if defined(__x86_64__)
+  if (slider_tables.use_pext)
+    return slider_attacks_pext(slider_tables.bishop, square, occupied);
+#endif
+  return bishop_attacks_generic(square, occupied);
+}
 }; // namespace mcc
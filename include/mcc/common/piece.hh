@@ -2,6 +2,8 @@
 
 #include "colour.hh"
 
+#include <array>
+#include <bit>
 #include <ostream>
 
 namespace mcc {
@@ -14,6 +16,18 @@ enum class Piece {
   King = 32
 };
 
+constexpr std::array<Piece, 6> get_all_pieces() {
+  using enum Piece;
+  return {Pawn, Knight, Bishop, Rook, Queen, King};
+}
+
+/* Maps the one-hot piece encoding to a dense index in [0, 6), suitable for
+   indexing tables. Pawn -> 0, Rook -> 1, ..., King -> 5. */
+constexpr std::size_t piece_index(Piece piece) {
+  return static_cast<std::size_t>(
+      std::countr_zero(static_cast<unsigned int>(piece)));
+}
+
 struct ColouredPiece {
   Piece piece;
   Colour colour;
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "mcc/common.hh"
+#include "mcc/common/piece.hh"
+#include "mcc/mcc.hh"
+#include "mcc/move.hh"
+
+#include <cassert>
+#include <cstdint>
+
+namespace mcc {
+/*
+  A move stored in an unsigned 16bit integer, structured as follows:
+
+  | From (6 bits) | To (6 bits) | Kind (4 bits) |
+
+  Unlike Move, the moving piece and its colour are not stored, they are
+  determined by the board the move is played on. In exchange, the kind
+  distinguishes all special moves:
+    - Quiet           = 0
+    - DoublePawnPush  = 1
+    - KingCastle      = 2
+    - QueenCastle     = 3
+    - Capture         = 4
+    - EnPassant       = 5
+    - Promotion{Knight,Bishop,Rook,Queen}        = 8, 9, 10, 11
+    - PromotionCapture{Knight,Bishop,Rook,Queen} = 12, 13, 14, 15
+  ie. bit 2 of the kind is set for captures and bit 3 for promotions.
+
+  The default constructed move (all bits zero) is used as "no move".
+ */
+class CompactMove {
+  constexpr static std::uint16_t from_shift = 10;
+  constexpr static std::uint16_t to_shift = 4;
+  constexpr static std::uint16_t square_mask = 0x3f;
+  constexpr static std::uint16_t kind_mask = 0xf;
+
+public:
+  enum class Kind : std::uint8_t {
+    Quiet = 0,
+    DoublePawnPush = 1,
+    KingCastle = 2,
+    QueenCastle = 3,
+    Capture = 4,
+    EnPassant = 5,
+    PromotionKnight = 8,
+    PromotionBishop = 9,
+    PromotionRook = 10,
+    PromotionQueen = 11,
+    PromotionCaptureKnight = 12,
+    PromotionCaptureBishop = 13,
+    PromotionCaptureRook = 14,
+    PromotionCaptureQueen = 15
+  };
+
+  constexpr CompactMove() = default;
+
+  constexpr CompactMove(int from, int to, Kind kind)
+      : data{static_cast<std::uint16_t>(
+            (static_cast<unsigned int>(from) << from_shift) |
+            (static_cast<unsigned int>(to) << to_shift) |
+            static_cast<unsigned int>(kind))} {
+    assert(is_inside_chessboard(from));
+    assert(is_inside_chessboard(to));
+  }
+
+  /* Converts `move` which is to be played on `board`. The board is needed to
+     recognise en passant captures. */
+  static CompactMove from_move(const Move &move, const mcc &board) {
+    const auto from = static_cast<int>(move.get_from());
+    const auto to = static_cast<int>(move.get_to());
+    const auto piece = move.get_piece();
+
+    unsigned int kind = static_cast<unsigned int>(Kind::Quiet);
+    if (move.is_promotion()) {
+      kind = static_cast<unsigned int>(Kind::PromotionKnight);
+      switch (move.get_promotion_piece()) {
+      case Piece::Bishop:
+        kind += 1;
+        break;
+      case Piece::Rook:
+        kind += 2;
+        break;
+      case Piece::Queen:
+        kind += 3;
+        break;
+      default:
+        break;
+      }
+      if (move.is_capture())
+        kind |= static_cast<unsigned int>(Kind::Capture);
+    } else if (move.is_capture()) {
+      kind = static_cast<unsigned int>(
+          piece == Piece::Pawn && to == board.get_en_passant_square()
+              ? Kind::EnPassant
+              : Kind::Capture);
+    } else if (piece == Piece::Pawn && distance(from, to) == 2) {
+      kind = static_cast<unsigned int>(Kind::DoublePawnPush);
+    } else if (piece == Piece::King && distance(from, to) == 2) {
+      kind = static_cast<unsigned int>(to > from ? Kind::KingCastle
+                                                 : Kind::QueenCastle);
+    }
+
+    return {from, to, static_cast<Kind>(kind)};
+  }
+
+  /* Converts back to a Move to be played on `board`. The board must be the
+     one the move was created for, ie. there has to be a piece of the side to
+     move on the from square. */
+  Move to_move(const mcc &board) const {
+    const auto piece = board.get_piece_on(get_from());
+    assert(piece.has_value());
+
+    unsigned int flags = Move::Flags::None;
+    if (is_promotion()) {
+      constexpr Move::Flags promotions[] = {
+          Move::Flags::PromotionKnight, Move::Flags::PromotionBishop,
+          Move::Flags::PromotionRook, Move::Flags::PromotionQueen};
+      flags = promotions[static_cast<unsigned int>(get_kind()) & 0x3];
+      if (is_capture())
+        flags |= Move::Flags::Capture;
+    } else if (is_capture()) {
+      flags = Move::Flags::Capture;
+    }
+
+    return Move{get_from(), get_to(), piece.value(), board.get_active_colour(),
+                static_cast<Move::Flags>(flags)};
+  }
+
+  constexpr int get_from() const { return (data >> from_shift) & square_mask; }
+  constexpr int get_to() const { return (data >> to_shift) & square_mask; }
+  constexpr Kind get_kind() const { return static_cast<Kind>(data & kind_mask); }
+
+  constexpr bool is_capture() const { return data & 0x4; }
+  constexpr bool is_promotion() const { return data & 0x8; }
+  constexpr bool is_en_passant() const { return get_kind() == Kind::EnPassant; }
+  constexpr bool is_castling() const {
+    return get_kind() == Kind::KingCastle || get_kind() == Kind::QueenCastle;
+  }
+
+  // Returns the piece the pawn is promoted to. Only valid if is_promotion().
+  constexpr Piece get_promotion_piece() const {
+    constexpr Piece pieces[] = {Piece::Knight, Piece::Bishop, Piece::Rook,
+                                Piece::Queen};
+    return pieces[data & 0x3];
+  }
+
+  constexpr std::uint16_t get_raw() const { return data; }
+  constexpr static CompactMove from_raw(std::uint16_t raw) {
+    CompactMove move;
+    move.data = raw;
+    return move;
+  }
+
+  constexpr explicit operator bool() const { return data != 0; }
+  constexpr bool operator==(const CompactMove &other) const = default;
+
+private:
+  std::uint16_t data = 0;
+};
+
+static_assert(sizeof(CompactMove) == 2);
+} // namespace mcc
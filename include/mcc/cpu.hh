@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdlib>
+#include <string_view>
+
+namespace mcc::cpu {
+/*
+  Instruction set levels for which hot kernels are compiled. The library
+  itself is compiled for the baseline architecture, kernels for higher levels
+  are compiled with function-level target attributes and selected once at
+  startup based on the CPU the engine runs on. The kernels are the
+  evaluation (see eval.hh) and the PEXT lookup of slider attacks (see
+  helpers.hh).
+    - Generic: baseline x86-64 (or any other architecture)
+    - Popcnt:  hardware popcount (x86-64-v2)
+    - Bmi2:    hardware popcount and fast PEXT
+ */
+enum class Isa { Generic = 0, Popcnt = 1, Bmi2 = 2 };
+
+inline std::string_view isa_name(Isa isa) {
+  switch (isa) {
+  case Isa::Generic:
+    return "generic";
+  case Isa::Popcnt:
+    return "popcnt";
+  case Isa::Bmi2:
+    return "bmi2";
+  default:
+    __builtin_unreachable();
+  }
+}
+
+/* Returns the best instruction set level supported by the CPU. PEXT is
+   microcoded and slow on AMD CPUs before Zen 3, so BMI2 kernels are not used
+   there. The environment variable MCC_ISA (generic, popcnt or bmi2) lowers
+   the level, which is useful to compare the kernels. */
+inline Isa detect_isa() {
+  Isa isa = Isa::Generic;
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("popcnt"))
+    isa = Isa::Popcnt;
+  if (__builtin_cpu_supports("popcnt") && __builtin_cpu_supports("bmi2") &&
+      not __builtin_cpu_is("znver1") && not __builtin_cpu_is("znver2"))
+    isa = Isa::Bmi2;
+#endif
+
+  if (const char *requested = std::getenv("MCC_ISA")) {
+    for (auto level : {Isa::Generic, Isa::Popcnt, Isa::Bmi2}) {
+      if (isa_name(level) == requested && level < isa)
+        isa = level;
+    }
+  }
+  return isa;
+}
+
+// The instruction set level used by the engine, detected on first use
+inline Isa get_isa() {
+  static const Isa isa = detect_isa();
+  return isa;
+}
+} // namespace mcc::cpu
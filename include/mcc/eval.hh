@@ -0,0 +1,193 @@
+#pragma once
+
+#include "mcc/common/colour.hh"
+#include "mcc/common/piece.hh"
+#include "mcc/cpu.hh"
+#include "mcc/kpk.hh"
+#include "mcc/mcc.hh"
+#include "mcc/stats.hh"
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace mcc {
+/*
+  The evaluation is a simple sum of material and piece-square values. All
+  tables are indexed by piece_index(piece), ie. in the order
+    Pawn, Rook, Knight, Bishop, Queen, King
+
+  The piece-square tables are given from White's point of view, using the
+  same square numbering as the board (index 0 is a8, index 63 is h1). For
+  Black the tables are mirrored vertically.
+
+  King and pawn versus king is scored exactly with the bitbase from kpk.hh:
+  drawn positions are scored 0, won positions half a queen plus a bonus for
+  advancing the pawn. This stays below the value of the promoted queen, so
+  the search still promotes.
+ */
+struct EvalParams {
+  std::array<int, 6> material;
+  std::array<std::array<int, 64>, 6> pst;
+};
+
+// clang-format off
+constexpr inline EvalParams default_eval_params = {
+    {100, 500, 320, 330, 900, 0},
+    {{
+        // Pawn
+        {  0,   0,   0,   0,   0,   0,   0,   0,
+          50,  50,  50,  50,  50,  50,  50,  50,
+          10,  10,  20,  30,  30,  20,  10,  10,
+           5,   5,  10,  25,  25,  10,   5,   5,
+           0,   0,   0,  20,  20,   0,   0,   0,
+           5,  -5, -10,   0,   0, -10,  -5,   5,
+           5,  10,  10, -20, -20,  10,  10,   5,
+           0,   0,   0,   0,   0,   0,   0,   0},
+        // Rook
+        {  0,   0,   0,   0,   0,   0,   0,   0,
+           5,  10,  10,  10,  10,  10,  10,   5,
+          -5,   0,   0,   0,   0,   0,   0,  -5,
+          -5,   0,   0,   0,   0,   0,   0,  -5,
+          -5,   0,   0,   0,   0,   0,   0,  -5,
+          -5,   0,   0,   0,   0,   0,   0,  -5,
+          -5,   0,   0,   0,   0,   0,   0,  -5,
+           0,   0,   0,   5,   5,   0,   0,   0},
+        // Knight
+        {-50, -40, -30, -30, -30, -30, -40, -50,
+         -40, -20,   0,   0,   0,   0, -20, -40,
+         -30,   0,  10,  15,  15,  10,   0, -30,
+         -30,   5,  15,  20,  20,  15,   5, -30,
+         -30,   0,  15,  20,  20,  15,   0, -30,
+         -30,   5,  10,  15,  15,  10,   5, -30,
+         -40, -20,   0,   5,   5,   0, -20, -40,
+         -50, -40, -30, -30, -30, -30, -40, -50},
+        // Bishop
+        {-20, -10, -10, -10, -10, -10, -10, -20,
+         -10,   0,   0,   0,   0,   0,   0, -10,
+         -10,   0,   5,  10,  10,   5,   0, -10,
+         -10,   5,   5,  10,  10,   5,   5, -10,
+         -10,   0,  10,  10,  10,  10,   0, -10,
+         -10,  10,  10,  10,  10,  10,  10, -10,
+         -10,   5,   0,   0,   0,   0,   5, -10,
+         -20, -10, -10, -10, -10, -10, -10, -20},
+        // Queen
+        {-20, -10, -10,  -5,  -5, -10, -10, -20,
+         -10,   0,   0,   0,   0,   0,   0, -10,
+         -10,   0,   5,   5,   5,   5,   0, -10,
+          -5,   0,   5,   5,   5,   5,   0,  -5,
+           0,   0,   5,   5,   5,   5,   0,  -5,
+         -10,   5,   5,   5,   5,   5,   0, -10,
+         -10,   0,   5,   0,   0,   0,   0, -10,
+         -20, -10, -10,  -5,  -5, -10, -10, -20},
+        // King
+        {-30, -40, -40, -50, -50, -40, -40, -30,
+         -30, -40, -40, -50, -50, -40, -40, -30,
+         -30, -40, -40, -50, -50, -40, -40, -30,
+         -30, -40, -40, -50, -50, -40, -40, -30,
+         -20, -30, -30, -40, -40, -30, -30, -20,
+         -10, -20, -20, -20, -20, -20, -20, -10,
+          20,  20,   0,   0,   0,   0,  20,  20,
+          20,  30,  10,   0,   0,  10,  30,  20},
+    }}};
+// clang-format on
+
+// Returns the value of `piece` in centipawns
+inline int piece_value(Piece piece,
+                       const EvalParams &params = default_eval_params) {
+  return params.material[piece_index(piece)];
+}
+
+namespace detail {
+// Returns the exact score of the position if it is king and pawn versus king
+inline std::optional<int> evaluate_kpk(const mcc &board,
+                                       const EvalParams &params) {
+  if (std::popcount(board.get_occupied()) != 3)
+    return {};
+
+  const auto white_pawns = board.get_bitboard(Piece::Pawn, Colour::White);
+  const auto black_pawns = board.get_bitboard(Piece::Pawn, Colour::Black);
+  if (not(white_pawns | black_pawns))
+    return {};
+
+  // Flip the board so that the pawn is White's and on files a-d
+  const auto strong = white_pawns ? Colour::White : Colour::Black;
+  int flip = strong == Colour::White ? 0 : 56;
+  if (kpk::file_of(std::countr_zero(white_pawns | black_pawns) ^ flip) > 3)
+    flip ^= 7;
+
+  const auto square_of = [&](Piece piece, Colour colour) {
+    return std::countr_zero(board.get_bitboard(piece, colour)) ^ flip;
+  };
+  const int pawn = square_of(Piece::Pawn, strong);
+  const auto us = board.get_active_colour();
+
+  if (not kpk::probe(us == strong ? Colour::White : Colour::Black,
+                     square_of(Piece::King, strong), pawn,
+                     square_of(Piece::King, get_other_colour(strong))))
+    return 0;
+
+  const int score =
+      params.material[piece_index(Piece::Queen)] / 2 + 20 * kpk::rank_of(pawn);
+  return us == strong ? score : -score;
+}
+
+inline int evaluate_generic(const mcc &board, const EvalParams &params) {
+  if (const auto score = evaluate_kpk(board, params))
+    return *score;
+
+  int score[2] = {0, 0};
+
+  for (auto colour : {Colour::White, Colour::Black}) {
+    // Mirror the tables vertically for Black
+    const int flip = colour == Colour::White ? 0 : 56;
+
+    for (auto piece : get_all_pieces()) {
+      const auto index = piece_index(piece);
+      auto bitboard = board.get_bitboard(piece, colour);
+
+      score[colour] += std::popcount(bitboard) * params.material[index];
+      while (bitboard) {
+        const auto square =
+            static_cast<std::size_t>(std::countr_zero(bitboard) ^ flip);
+        score[colour] += params.pst[index][square];
+        bitboard &= bitboard - 1;
+      }
+    }
+  }
+
+  const auto us = board.get_active_colour();
+  return score[us] - score[get_other_colour(us)];
+}
+
+/* The same evaluation compiled for CPUs with a popcount instruction. Without
+   it (the baseline x86-64 target), std::popcount is a library call.
+   `flatten` inlines the generic code, including the KPK check, into this
+   kernel. */
+#if defined(__x86_64__)
+__attribute__((target("popcnt"), flatten)) inline int
+evaluate_popcnt(const mcc &board, const EvalParams &params) {
+  return evaluate_generic(board, params);
+}
+#endif
+
+// Selected once at startup, see cpu.hh
+inline const bool use_popcnt = cpu::get_isa() >= cpu::Isa::Popcnt;
+} // namespace detail
+
+/* Evaluates the position statically. The score is returned in centipawns from
+   the point of view of the side to move. The popcount kernel is selected with
+   a (perfectly predicted) branch rather than a function pointer, so that
+   evaluate() itself can still be inlined. */
+inline int evaluate(const mcc &board,
+                    const EvalParams &params = default_eval_params) {
+  stats::ScopedTimer timer{stats::EvalTime, stats::Evaluations};
+#if defined(__x86_64__)
+  if (detail::use_popcnt)
+    return detail::evaluate_popcnt(board, params);
+#endif
+  return detail::evaluate_generic(board, params);
+}
+} // namespace mcc
@@ -0,0 +1,175 @@
+#pragma once
+
+#include "mcc/common/colour.hh"
+#include "mcc/common/helpers.hh"
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mcc::kpk {
+/*
+  Bitbase for king and pawn versus king. For every position with White to
+  move or Black to move, with the pawn on files a-d (the other files are
+  mirrored), it stores one bit: whether White wins. The positions are
+  indexed by
+    white king | black king << 6 | side to move << 12 | pawn file << 13 |
+    (6 - pawn rank) << 15
+  which gives 2 * 4 * 6 * 64 * 64 bits = 24 KB. Squares use the board
+  numbering (a8 = 0, h1 = 63), ranks are counted from 0 (White's first rank)
+  and the pawn is on ranks 1 (second rank) to 6 (seventh rank).
+
+  The bitbase is computed at startup by retrograde analysis: positions that
+  are immediately won (the pawn promotes safely) or drawn (stalemate, the
+  pawn is lost) are classified first, then the remaining positions are
+  classified from their successors until nothing changes anymore.
+ */
+constexpr std::size_t max_index = 2 * 4 * 6 * 64 * 64;
+
+constexpr int file_of(int square) { return square & 7; }
+constexpr int rank_of(int square) { return 7 - (square >> 3); }
+
+constexpr std::size_t index(Colour side_to_move, int white_king,
+                            int black_king, int pawn) {
+  return static_cast<std::size_t>(white_king | (black_king << 6) |
+                                  (side_to_move << 12) |
+                                  (file_of(pawn) << 13) |
+                                  ((6 - rank_of(pawn)) << 15));
+}
+
+namespace detail {
+enum Result : uint8_t { Invalid = 0, Unknown = 1, Draw = 2, Win = 4 };
+
+constexpr int north = -8;
+
+constexpr int distance(int a, int b) {
+  const int files = file_of(a) > file_of(b) ? file_of(a) - file_of(b)
+                                            : file_of(b) - file_of(a);
+  const int ranks = rank_of(a) > rank_of(b) ? rank_of(a) - rank_of(b)
+                                            : rank_of(b) - rank_of(a);
+  return files > ranks ? files : ranks;
+}
+
+constexpr uint64_t bit(int square) { return uint64_t{1} << square; }
+
+constexpr uint64_t king_attacks(int square) {
+  return king_attack_board[static_cast<std::size_t>(square)];
+}
+
+struct Position {
+  Colour side_to_move;
+  int white_king;
+  int black_king;
+  int pawn;
+};
+
+// Inverse of index()
+constexpr Position decode(std::size_t idx) {
+  const auto field = [idx](int shift, std::size_t mask) {
+    return static_cast<int>((idx >> shift) & mask);
+  };
+  return {static_cast<Colour>(field(12, 1)), field(0, 0x3F), field(6, 0x3F),
+          field(13, 3) + 8 * (1 + field(15, 7))};
+}
+
+// Classification of a position that does not need its successors
+inline Result classify_initial(std::size_t idx) {
+  const auto [side_to_move, white_king, black_king, pawn] = decode(idx);
+
+  const auto pawn_attacks_white = pawn_attacks<Colour::White>(bit(pawn));
+
+  // Kings next to each other, two pieces on a square or Black in check with
+  // White to move
+  if (distance(white_king, black_king) <= 1 || white_king == pawn ||
+      black_king == pawn ||
+      (side_to_move == Colour::White &&
+       (pawn_attacks_white & bit(black_king))))
+    return Invalid;
+
+  // The pawn promotes and the queen cannot be captured
+  if (side_to_move == Colour::White && rank_of(pawn) == 6 &&
+      white_king != pawn + north &&
+      (distance(black_king, pawn + north) > 1 ||
+       distance(white_king, pawn + north) == 1))
+    return Win;
+
+  // Stalemate, or Black captures the undefended pawn
+  if (side_to_move == Colour::Black &&
+      (not(king_attacks(black_king) &
+           ~(king_attacks(white_king) | pawn_attacks_white)) ||
+       (king_attacks(black_king) & ~king_attacks(white_king) & bit(pawn))))
+    return Draw;
+
+  return Unknown;
+}
+
+/* Classifies a position from its successors. With White to move, the
+   position is won if one move wins and drawn if all moves draw. With Black
+   to move, it is drawn if one move draws and won if all moves win. */
+inline Result classify(const std::vector<Result> &db, std::size_t idx) {
+  const auto [side_to_move, white_king, black_king, pawn] = decode(idx);
+
+  const auto good = side_to_move == Colour::White ? Win : Draw;
+  const auto bad = side_to_move == Colour::White ? Draw : Win;
+
+  // Moves to illegal positions are Invalid and do not change the result
+  unsigned int result = Invalid;
+  if (side_to_move == Colour::White) {
+    for (auto b = king_attacks(white_king); b; b &= b - 1)
+      result |= db[index(Colour::Black, std::countr_zero(b), black_king, pawn)];
+
+    if (rank_of(pawn) < 6)
+      result |= db[index(Colour::Black, white_king, black_king, pawn + north)];
+    if (rank_of(pawn) == 1 && pawn + north != white_king &&
+        pawn + north != black_king)
+      result |=
+          db[index(Colour::Black, white_king, black_king, pawn + 2 * north)];
+  } else {
+    for (auto b = king_attacks(black_king); b; b &= b - 1)
+      result |= db[index(Colour::White, white_king, std::countr_zero(b), pawn)];
+  }
+
+  return result & good ? good : result & Unknown ? Unknown : bad;
+}
+} // namespace detail
+
+using Bitbase = std::array<uint64_t, max_index / 64>;
+
+inline Bitbase generate() {
+  using namespace detail;
+
+  std::vector<Result> db(max_index);
+  for (std::size_t idx = 0; idx < max_index; ++idx)
+    db[idx] = classify_initial(idx);
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (std::size_t idx = 0; idx < max_index; ++idx) {
+      if (db[idx] != Unknown)
+        continue;
+      db[idx] = classify(db, idx);
+      changed |= db[idx] != Unknown;
+    }
+  }
+
+  // Positions that are still unknown cannot be won by White
+  Bitbase bitbase = {};
+  for (std::size_t idx = 0; idx < max_index; ++idx)
+    if (db[idx] == Win)
+      bitbase[idx / 64] |= uint64_t{1} << (idx % 64);
+  return bitbase;
+}
+
+inline const Bitbase bitbase = generate();
+
+/* Returns true if White wins the position with White's king, pawn and
+   Black's king on the given squares. The pawn must be on files a-d. */
+inline bool probe(Colour side_to_move, int white_king, int pawn,
+                  int black_king) {
+  const auto idx = index(side_to_move, white_king, black_king, pawn);
+  return (bitbase[idx / 64] >> (idx % 64)) & 1;
+}
+} // namespace mcc::kpk
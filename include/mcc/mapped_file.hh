@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mcc {
+/* Read-only memory mapping of a whole file. The file contents are paged in by
+   the OS on demand and are never copied to the heap. Throws a
+   std::runtime_error if the file cannot be opened or mapped. */
+class MappedFile {
+public:
+  explicit MappedFile(const std::filesystem::path &path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::runtime_error("[mcc::MappedFile] Cannot open file " +
+                               path.string());
+
+    struct stat info = {};
+    if (::fstat(fd, &info) != 0) {
+      ::close(fd);
+      throw std::runtime_error("[mcc::MappedFile] Cannot stat file " +
+                               path.string());
+    }
+
+    size = static_cast<std::size_t>(info.st_size);
+    if (size > 0) {
+      void *mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapping == MAP_FAILED) {
+        ::close(fd);
+        throw std::runtime_error("[mcc::MappedFile] Cannot map file " +
+                                 path.string());
+      }
+      mapped = static_cast<const char *>(mapping);
+    }
+    ::close(fd);
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  MappedFile(MappedFile &&other) noexcept
+      : mapped{std::exchange(other.mapped, nullptr)},
+        size{std::exchange(other.size, 0)} {}
+
+  MappedFile &operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+      unmap();
+      mapped = std::exchange(other.mapped, nullptr);
+      size = std::exchange(other.size, 0);
+    }
+    return *this;
+  }
+
+  ~MappedFile() { unmap(); }
+
+  // Hints the OS that the file is going to be read front to back
+  void advise_sequential() const {
+    if (mapped)
+      ::madvise(const_cast<char *>(mapped), size, MADV_SEQUENTIAL);
+  }
+
+  // Hints the OS that the file is accessed at random places, so that it does
+  // not read ahead
+  void advise_random() const {
+    if (mapped)
+      ::madvise(const_cast<char *>(mapped), size, MADV_RANDOM);
+  }
+
+  const char *data() const { return mapped; }
+  std::size_t get_size() const { return size; }
+  std::string_view view() const { return {mapped, size}; }
+
+private:
+  void unmap() {
+    if (mapped)
+      ::munmap(const_cast<char *>(mapped), size);
+    mapped = nullptr;
+    size = 0;
+  }
+
+  const char *mapped = nullptr;
+  std::size_t size = 0;
+};
+} // namespace mcc
@@ -3,16 +3,20 @@
 #include "mcc/common.hh"
 #include "mcc/common/colour.hh"
 #include "mcc/common/direction.hh"
+#include "mcc/common/helpers.hh"
 #include "mcc/common/piece.hh"
 #include "mcc/move.hh"
+#include "mcc/stats.hh"
+#include "mcc/zobrist.hh"
 
+#include <algorithm>
 #include <bit>
 #include <bitset>
 #include <exception>
 #include <optional>
-#include <sstream>
+#include <stdexcept>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 
 /*
@@ -47,7 +51,12 @@
 namespace mcc {
 constexpr int NO_EN_PASSANT = -1;
 
+struct PackedPosition;
+
 class mcc {
+  // Packing and unpacking needs direct access to the board state
+  friend struct PackedPosition;
+
   // Piece bitboards
   // piece[Colour::White] -> White pieces
   // piece[Colour::Black] -> Black pieces
@@ -69,12 +78,222 @@ class mcc {
   unsigned int half_moves = 0;
   unsigned int full_moves = 0;
 
+  // Zobrist key of the current position, see zobrist.hh
+  uint64_t key = 0;
+  // Number of moves since the last null move (or since the board was set up)
+  unsigned int plies_since_null = 0;
+
+  /* Everything that is needed to take back a move. Since the board is only a
+     handful of bitboards, we simply store a copy of the complete state before
+     each move instead of reverting the move incrementally. */
+  struct State {
+    uint64_t pawns[2];
+    uint64_t rooks[2];
+    uint64_t knights[2];
+    uint64_t bishops[2];
+    uint64_t queens[2];
+    uint64_t king[2];
+
+    int en_passant_square;
+    Colour active_colour;
+
+    bool white_can_castle_kingside;
+    bool white_can_castle_queenside;
+    bool black_can_castle_kingside;
+    bool black_can_castle_queenside;
+
+    unsigned int half_moves;
+    unsigned int full_moves;
+
+    uint64_t key;
+    unsigned int plies_since_null;
+  };
+  /* The states before each move. Besides taking back moves, this is the stack
+     of position keys used to detect repetitions. */
+  std::vector<State> history;
+
+  // Returns the (const or non-const) bitboard pair of the given piece type
+  template <typename Self> static auto *bitboard_of(Self &self, Piece piece) {
+    switch (piece) {
+    case Piece::Pawn:
+      return self.pawns;
+    case Piece::Knight:
+      return self.knights;
+    case Piece::Bishop:
+      return self.bishops;
+    case Piece::Rook:
+      return self.rooks;
+    case Piece::Queen:
+      return self.queens;
+    case Piece::King:
+      return self.king;
+    default:
+      __builtin_unreachable();
+    }
+  }
+
 public:
-  mcc(const std::string &fen =
+  mcc(std::string_view fen =
           "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1") {
     load_from_fen(fen);
   }
 
+  /* Sets up the board from the given FEN string, replacing the current
+     position and clearing the move history. The half and full move counters
+     are optional (defaulting to 0 and 1) and may be followed by EPD
+     operations, so EPD lines (eg. "<fen> bm e4; id x;") can be loaded
+     as well. Other trailing text is rejected.
+     The string is parsed in a single pass without allocating. Returns false
+     if the FEN is invalid or describes an illegal position (see below), the
+     board is left in an unspecified state then.
+   */
+  bool load_from_fen(std::string_view fen) {
+    for (auto *bitboard : {pawns, knights, bishops, rooks, queens, king})
+      bitboard[Colour::White] = bitboard[Colour::Black] = 0;
+    history.clear();
+    plies_since_null = 0;
+
+    // Trailing white space (eg. from Windows line endings) is ignored
+    fen = fen.substr(0, fen.find_last_not_of(" \t\r\n") + 1);
+    std::size_t pos = 0;
+    const auto at_end_of_field = [&]() {
+      return pos == fen.size() || fen[pos] == ' ';
+    };
+    const auto next_field = [&]() {
+      while (pos < fen.size() && fen[pos] == ' ')
+        ++pos;
+      return pos < fen.size();
+    };
+
+    // Process pieces, the first rank in FEN is rank 8
+    if (not next_field())
+      return false;
+    std::size_t file = 0;
+    std::size_t rank = 7;
+    for (; not at_end_of_field(); ++pos) {
+      const char curr = fen[pos];
+      if (curr == '/') {
+        if (file != 8 || rank == 0)
+          return false;
+        file = 0;
+        --rank;
+      } else if (curr >= '1' && curr <= '8') {
+        file += static_cast<std::size_t>(curr - '0');
+        if (file > 8)
+          return false;
+      } else {
+        if (file > 7 || not set_piece_at(file, rank, curr))
+          return false;
+        ++file;
+      }
+    }
+    if (file != 8 || rank != 0)
+      return false;
+
+    // Process active colour field
+    if (not next_field())
+      return false;
+    switch (fen[pos++]) {
+    case 'w':
+      active_colour = Colour::White;
+      break;
+    case 'b':
+      active_colour = Colour::Black;
+      break;
+    default:
+      return false;
+    }
+    if (not at_end_of_field())
+      return false;
+
+    // Process castling rights, any subset of "KQkq" (or "-")
+    if (not next_field())
+      return false;
+    white_can_castle_kingside = false;
+    white_can_castle_queenside = false;
+    black_can_castle_kingside = false;
+    black_can_castle_queenside = false;
+    if (fen[pos] == '-') {
+      ++pos;
+    } else {
+      for (; not at_end_of_field(); ++pos) {
+        switch (fen[pos]) {
+        case 'K':
+          white_can_castle_kingside = true;
+          break;
+        case 'Q':
+          white_can_castle_queenside = true;
+          break;
+        case 'k':
+          black_can_castle_kingside = true;
+          break;
+        case 'q':
+          black_can_castle_queenside = true;
+          break;
+        default:
+          return false;
+        }
+      }
+    }
+    if (not at_end_of_field())
+      return false;
+
+    // Process en passant square
+    if (not next_field())
+      return false;
+    if (fen[pos] == '-') {
+      en_passant_square = NO_EN_PASSANT;
+      ++pos;
+    } else {
+      // The rank has to match the side to move, the pawn behind the square
+      // is checked by is_valid()
+      const bool white = active_colour == Colour::White;
+      if (pos + 1 >= fen.size() || fen[pos] < 'a' || fen[pos] > 'h' ||
+          fen[pos + 1] != (white ? '6' : '3'))
+        return false;
+      en_passant_square = from_algebraic_to_64(
+          static_cast<std::uint8_t>(fen[pos] - 'a'),
+          static_cast<std::uint8_t>(fen[pos + 1] - '1'));
+      pos += 2;
+    }
+    if (not at_end_of_field())
+      return false;
+
+    // Process half and full moves, if present. A counter has to be a number
+    // (of at most seven digits) on its own.
+    const auto parse_counter = [&](unsigned int &counter,
+                                   unsigned int default_value) {
+      counter = default_value;
+      if (not next_field() || fen[pos] < '0' || fen[pos] > '9')
+        return true;
+      counter = 0;
+      for (int digits = 0; not at_end_of_field(); ++pos, ++digits) {
+        if (fen[pos] < '0' || fen[pos] > '9' || digits == 7)
+          return false;
+        counter = 10 * counter + static_cast<unsigned int>(fen[pos] - '0');
+      }
+      return true;
+    };
+    if (not parse_counter(half_moves, 0) || not parse_counter(full_moves, 1))
+      return false;
+
+    // Anything else has to be EPD operations, each an opcode followed by
+    // operands and terminated by a semicolon
+    if (next_field()) {
+      const char first = fen[pos];
+      if (not((first >= 'a' && first <= 'z') ||
+              (first >= 'A' && first <= 'Z')) ||
+          fen.back() != ';')
+        return false;
+    }
+
+    if (not is_valid())
+      return false;
+
+    key = compute_key();
+    return true;
+  }
+
   std::optional<ColouredPiece> get_piece_at(std::size_t file,
                                             std::size_t rank) const {
     using enum Colour;
@@ -117,6 +336,18 @@ public:
     return {};
   }
 
+  // Returns the type of the piece on `square` (of either colour), if any
+  std::optional<Piece> get_piece_on(int square) const {
+    const auto position = static_cast<std::uint8_t>(square);
+    for (auto piece : get_all_pieces()) {
+      const auto *bitboard = bitboard_of(*this, piece);
+      if (bit_is_set(bitboard[Colour::White] | bitboard[Colour::Black],
+                     position))
+        return piece;
+    }
+    return {};
+  }
+
   /* Performs the given move form position `from` to position `to`.
      Throws an exception if either of the positions (or both) are outside the
      board or if there is no piece at the position `from`. Otherwise does not
@@ -140,7 +371,7 @@ public:
 
           // Check if move is capture
           for (auto &other_bitboards : bitboards) {
-            auto &other_bitboard = bitboard[get_other_colour(colour)];
+            auto &other_bitboard = other_bitboards[get_other_colour(colour)];
 
             if (bit_is_set(other_bitboard, to))
               clear_bit(&other_bitboard, to);
@@ -155,119 +386,372 @@ public:
     throw std::invalid_argument("[mcc::make_move] No piece at given positon.");
   }
 
+  /* Performs the given move and switches the side to move. The move is
+     expected to be (at least pseudo-)legal in the current position. Castling
+     is encoded as a king move by two files, en passant as a pawn capture onto
+     the en passant square. The move can be taken back with unmake_move().
+   */
+  void make_move(const Move &move) {
+    stats::ScopedTimer timer{stats::MakeMoveTime, stats::MakeMoves};
+    history.push_back(save_state());
+
+    using enum Piece;
+    const auto us = active_colour;
+    const auto them = get_other_colour(us);
+    const auto from = static_cast<std::uint8_t>(move.get_from());
+    const auto to = static_cast<std::uint8_t>(move.get_to());
+    const auto piece = move.get_piece();
+
+    key ^= castling_key() ^ en_passant_key();
+
+    if (move.is_capture()) {
+      if (piece == Pawn && static_cast<int>(to) == en_passant_square) {
+        const auto captured_square =
+            static_cast<std::uint8_t>(us == Colour::White ? to + 8 : to - 8);
+        clear_bit(&pawns[them], captured_square);
+        key ^= zobrist::piece_key(them, Pawn, captured_square);
+      } else {
+        for (auto captured : {Pawn, Knight, Bishop, Rook, Queen}) {
+          auto *bitboard = bitboard_of(*this, captured);
+          if (bit_is_set(bitboard[them], to)) {
+            clear_bit(&bitboard[them], to);
+            key ^= zobrist::piece_key(them, captured, to);
+            break;
+          }
+        }
+      }
+    }
+
+    const auto placed = move.is_promotion() ? move.get_promotion_piece() : piece;
+    clear_bit(&bitboard_of(*this, piece)[us], from);
+    set_bit(&bitboard_of(*this, placed)[us], to);
+    key ^= zobrist::piece_key(us, piece, from) ^
+           zobrist::piece_key(us, placed, to);
+
+    // Castling: the king moves two files, move the rook along with it
+    if (piece == King && distance(from, to) == 2) {
+      const bool kingside = to > from;
+      const auto rook_from =
+          static_cast<std::uint8_t>(kingside ? from + 3 : from - 4);
+      const auto rook_to =
+          static_cast<std::uint8_t>(kingside ? from + 1 : from - 1);
+      clear_bit(&rooks[us], rook_from);
+      set_bit(&rooks[us], rook_to);
+      key ^= zobrist::piece_key(us, Rook, rook_from) ^
+             zobrist::piece_key(us, Rook, rook_to);
+    }
+
+    // Moving the king or a rook, or capturing a rook, removes castling rights
+    for (auto square : {from, to}) {
+      switch (square) {
+      case 60:
+        white_can_castle_kingside = white_can_castle_queenside = false;
+        break;
+      case 63:
+        white_can_castle_kingside = false;
+        break;
+      case 56:
+        white_can_castle_queenside = false;
+        break;
+      case 4:
+        black_can_castle_kingside = black_can_castle_queenside = false;
+        break;
+      case 7:
+        black_can_castle_kingside = false;
+        break;
+      case 0:
+        black_can_castle_queenside = false;
+        break;
+      default:
+        break;
+      }
+    }
+
+    if (piece == Pawn && distance(from, to) == 2 && (from % 8) == (to % 8))
+      en_passant_square = (from + to) / 2;
+    else
+      en_passant_square = NO_EN_PASSANT;
+
+    // Pawn moves and captures are irreversible and reset the fifty move rule
+    if (piece == Pawn || move.is_capture())
+      half_moves = 0;
+    else
+      ++half_moves;
+    if (us == Colour::Black)
+      ++full_moves;
+    ++plies_since_null;
+
+    active_colour = them;
+    key ^= castling_key() ^ en_passant_key() ^ zobrist::keys.side;
+  }
+
+  // Takes back the last move made with make_move() or make_null_move().
+  void unmake_move() {
+    restore_state(history.back());
+    history.pop_back();
+  }
+
+  /* Passes the turn to the other side without moving a piece. Used by the
+     search for null move pruning. Take back with unmake_move(). */
+  void make_null_move() {
+    history.push_back(save_state());
+    key ^= en_passant_key() ^ zobrist::keys.side;
+    en_passant_square = NO_EN_PASSANT;
+    active_colour = get_other_colour(active_colour);
+    plies_since_null = 0;
+  }
+
+  uint64_t get_key() const { return key; }
+
+  unsigned int get_half_moves() const { return half_moves; }
+
+  /* Returns true if the current position is a draw by the fifty move rule or
+     if it already occurred before. Counting the first repetition as a draw is
+     only correct inside the search tree (the side that repeats could do so
+     again); decisions about the actual game must use is_game_drawn(). */
+  bool is_draw() const { return is_fifty_move_draw() || is_repetition(); }
+
+  // Returns true if the game is drawn by the fifty move rule or by threefold
+  // repetition
+  bool is_game_drawn() const { return is_fifty_move_draw() || is_threefold(); }
+
+  // Returns true if fifty moves were made without a capture or pawn move and
+  // the side to move is not mated
+  bool is_fifty_move_draw() const {
+    return half_moves >= 100 &&
+           (not in_check() || not generate_moves().empty());
+  }
+
+  // Checks if the current position occurred before
+  bool is_repetition() const { return count_repetitions(1) >= 1; }
+
+  // Checks if the current position occurred (at least) twice before
+  bool is_threefold() const { return count_repetitions(2) >= 2; }
+
+  /* Checks if any position since the last irreversible move (the current one
+     included) is a repetition of an earlier one. Unlike is_repetition(), this
+     also finds repetitions earlier in the game, after which the position
+     was left again. */
+  bool has_repeated() const {
+    const auto end =
+        std::min<std::size_t>({half_moves, plies_since_null, history.size()});
+    const auto key_before = [this](std::size_t plies) {
+      return plies == 0 ? key : history[history.size() - plies].key;
+    };
+    for (std::size_t i = 0; i + 4 <= end; ++i) {
+      for (std::size_t j = i + 4; j <= end; j += 2) {
+        if (key_before(i) == key_before(j))
+          return true;
+      }
+    }
+    return false;
+  }
+
+  /* Counts how often the current position occurred before, stopping once
+     `limit` occurrences are found. Only positions since the last irreversible
+     move (and the last null move) can be equal to the current one, and only
+     every other position has the same side to move. */
+  int count_repetitions(int limit) const {
+    const auto end =
+        std::min<std::size_t>({half_moves, plies_since_null, history.size()});
+    int count = 0;
+    for (std::size_t i = 4; i <= end && count < limit; i += 2) {
+      if (history[history.size() - i].key == key)
+        ++count;
+    }
+    return count;
+  }
+
+  /* Checks if the side to move has a move that leads to a position that
+     already occurred in the search tree, using the cuckoo tables from
+     zobrist.hh. `ply` is the distance to the root of the search; repetitions
+     of positions before the root are not considered. */
+  bool has_upcoming_repetition(int ply) const {
+    const auto end =
+        std::min<std::size_t>({half_moves, plies_since_null, history.size()});
+    if (end < 3)
+      return false;
+
+    const auto key_before = [this](std::size_t plies) {
+      return history[history.size() - plies].key;
+    };
+
+    uint64_t other = key ^ key_before(1) ^ zobrist::keys.side;
+    for (std::size_t i = 3; i <= end && static_cast<int>(i) < ply; i += 2) {
+      other ^= key_before(i - 1) ^ key_before(i) ^ zobrist::keys.side;
+      if (other != 0)
+        continue;
+
+      const auto move_key = key ^ key_before(i);
+      auto slot = zobrist::Cuckoo::h1(move_key);
+      if (zobrist::cuckoo.keys[slot] != move_key)
+        slot = zobrist::Cuckoo::h2(move_key);
+      if (zobrist::cuckoo.keys[slot] != move_key)
+        continue;
+
+      // The move is only possible if no piece is in the way
+      const int s1 = zobrist::cuckoo.from[slot];
+      const int s2 = zobrist::cuckoo.to[slot];
+      const auto s1_bb = 1UL << s1;
+      const auto s2_bb = 1UL << s2;
+      uint64_t between = 0;
+      if (rook_attacks(s1, 0) & s2_bb)
+        between = rook_attacks(s1, s2_bb) & rook_attacks(s2, s1_bb);
+      else if (bishop_attacks(s1, 0) & s2_bb)
+        between = bishop_attacks(s1, s2_bb) & bishop_attacks(s2, s1_bb);
+      if (not(between & get_occupied()))
+        return true;
+    }
+    return false;
+  }
+
   // Generates all legal moves
   std::vector<Move> generate_moves() const {
+    stats::ScopedTimer timer{stats::MovegenTime, stats::MovegenCalls};
     std::vector<Move> moves;
+    moves.reserve(64);
 
-    ////////////////////////////////////
-    // Step 1: Identify pinned pieces //
-    ////////////////////////////////////
-
-    /* This map holds the position of pinned pieces as the keys and the
-     * direction along which it is pinned (ie. along which it is allowed to
-     * move) as the value. */
-    std::unordered_map<unsigned int, Direction> pinned_positions;
-    for (auto direction : get_all_directions()) {
-      if (auto position = get_pinned_in_dir(direction))
-        pinned_positions.insert({position.value(), direction});
-    }
+    generate_pawn_moves(moves);
+    generate_piece_moves(moves);
+    generate_castling_moves(moves);
+
+    // Remove all pseudo-legal moves that leave our own king in check
+    std::erase_if(moves, [this](const Move &move) { return not is_legal(move); });
 
-    generate_pawn_moves(moves, pinned_positions);
+    stats::add(stats::MovesGenerated, moves.size());
 
     return moves;
   }
 
-private:
+  Colour get_active_colour() const { return active_colour; }
+
+  int get_en_passant_square() const { return en_passant_square; }
+
+  /* Returns the castling rights as a set of bits: 1 = White kingside, 2 =
+     White queenside, 4 = Black kingside, 8 = Black queenside */
+  std::size_t get_castling_rights() const {
+    return zobrist::castling_index(
+        white_can_castle_kingside, white_can_castle_queenside,
+        black_can_castle_kingside, black_can_castle_queenside);
+  }
+
+  uint64_t get_bitboard(Piece piece, Colour colour) const {
+    return bitboard_of(*this, piece)[colour];
+  }
+
+  uint64_t get_occupied() const {
+    return occupied_by(Colour::White) | occupied_by(Colour::Black);
+  }
+
   uint64_t occupied_by(Colour colour) const {
     return pawns[colour] | knights[colour] | bishops[colour] | queens[colour] |
            rooks[colour] | king[colour];
   }
 
-  bool load_from_fen(const std::string &fen) {
-    std::vector<std::string> fenFields;
-    std::stringstream ss{fen};
-    std::string temp;
+  // Bitboard of all knights, bishops, rooks and queens of the given colour
+  uint64_t non_pawn_material(Colour colour) const {
+    return knights[colour] | bishops[colour] | rooks[colour] | queens[colour];
+  }
 
-    while (ss >> temp)
-      fenFields.push_back(std::move(temp));
+  // Returns all pieces (of both colours) that attack `square`, given the
+  // occupancy `occupied`.
+  uint64_t attackers_to(int square, uint64_t occupied) const {
+    const auto sq = static_cast<std::size_t>(square);
+    const auto rook_like = rooks[Colour::White] | rooks[Colour::Black] |
+                           queens[Colour::White] | queens[Colour::Black];
+    const auto bishop_like = bishops[Colour::White] | bishops[Colour::Black] |
+                             queens[Colour::White] | queens[Colour::Black];
+    const auto square_bb = 1UL << sq;
+
+    return (pawn_attacks<Colour::Black>(square_bb) & pawns[Colour::White]) |
+           (pawn_attacks<Colour::White>(square_bb) & pawns[Colour::Black]) |
+           (knight_attack_board[sq] &
+            (knights[Colour::White] | knights[Colour::Black])) |
+           (king_attack_board[sq] & (king[Colour::White] | king[Colour::Black])) |
+           (rook_attacks(square, occupied) & rook_like) |
+           (bishop_attacks(square, occupied) & bishop_like);
+  }
 
-    if (fenFields.size() != 6)
-      return false;
+  bool is_square_attacked(int square, Colour by) const {
+    return attackers_to(square, get_occupied()) & occupied_by(by);
+  }
 
-    // Process active colour field
-    if (fenFields[1] == "w")
-      active_colour = Colour::White;
-    else
-      active_colour = Colour::Black;
+  // Returns true if the side to move is in check
+  bool in_check() const {
+    return is_square_attacked(std::countr_zero(king[active_colour]),
+                              get_other_colour(active_colour));
+  }
 
-    // Process castling rights
-    std::size_t cnt = 0;
-    const auto &castlingRights = fenFields[2];
-    white_can_castle_kingside = false;
-    white_can_castle_queenside = false;
-    black_can_castle_kingside = false;
-    black_can_castle_queenside = false;
+private:
+  State save_state() const {
+    State state;
+    std::copy_n(pawns, 2, state.pawns);
+    std::copy_n(rooks, 2, state.rooks);
+    std::copy_n(knights, 2, state.knights);
+    std::copy_n(bishops, 2, state.bishops);
+    std::copy_n(queens, 2, state.queens);
+    std::copy_n(king, 2, state.king);
+    state.en_passant_square = en_passant_square;
+    state.active_colour = active_colour;
+    state.white_can_castle_kingside = white_can_castle_kingside;
+    state.white_can_castle_queenside = white_can_castle_queenside;
+    state.black_can_castle_kingside = black_can_castle_kingside;
+    state.black_can_castle_queenside = black_can_castle_queenside;
+    state.half_moves = half_moves;
+    state.full_moves = full_moves;
+    state.key = key;
+    state.plies_since_null = plies_since_null;
+    return state;
+  }
 
-    if (castlingRights[cnt] == 'K') {
-      white_can_castle_kingside = true;
-      cnt++;
-    }
-    if (castlingRights[cnt] == 'Q') {
-      white_can_castle_queenside = true;
-      cnt++;
-    }
-    if (castlingRights[cnt] == 'k') {
-      black_can_castle_kingside = true;
-      cnt++;
-    }
-    if (castlingRights[cnt] == 'q') {
-      black_can_castle_queenside = true;
-    }
+  void restore_state(const State &state) {
+    std::copy_n(state.pawns, 2, pawns);
+    std::copy_n(state.rooks, 2, rooks);
+    std::copy_n(state.knights, 2, knights);
+    std::copy_n(state.bishops, 2, bishops);
+    std::copy_n(state.queens, 2, queens);
+    std::copy_n(state.king, 2, king);
+    en_passant_square = state.en_passant_square;
+    active_colour = state.active_colour;
+    white_can_castle_kingside = state.white_can_castle_kingside;
+    white_can_castle_queenside = state.white_can_castle_queenside;
+    black_can_castle_kingside = state.black_can_castle_kingside;
+    black_can_castle_queenside = state.black_can_castle_queenside;
+    half_moves = state.half_moves;
+    full_moves = state.full_moves;
+    key = state.key;
+    plies_since_null = state.plies_since_null;
+  }
 
-    // Process en passant square
-    const auto en_passant_square_fen = fenFields[3];
-    if (en_passant_square_fen == "-")
-      en_passant_square = NO_EN_PASSANT;
-    else {
-      en_passant_square = from_algebraic_to_64(en_passant_square_fen);
-      if (!is_inside_chessboard(en_passant_square))
-        return false;
-    }
+  uint64_t castling_key() const {
+    return zobrist::keys.castling[zobrist::castling_index(
+        white_can_castle_kingside, white_can_castle_queenside,
+        black_can_castle_kingside, black_can_castle_queenside)];
+  }
+
+  uint64_t en_passant_key() const {
+    if (en_passant_square == NO_EN_PASSANT)
+      return 0;
+    return zobrist::keys.en_passant[en_passant_square % 8];
+  }
 
-    // Process half moves
-    const auto &halfMovesFEN = fenFields[4];
-    half_moves = static_cast<unsigned int>(std::stoi(halfMovesFEN));
-
-    // Process half moves
-    const auto &fullMovesFEN = fenFields[5];
-    full_moves = static_cast<unsigned int>(std::stoi(fullMovesFEN));
-
-    // Process pieces
-    std::vector<std::string> fenRanks;
-    ss = std::stringstream(fenFields[0]);
-    while (std::getline(ss, temp, '/'))
-      fenRanks.push_back(std::move(temp));
-
-    // Save position separately, since files can be skipped in FEN
-    size_t position_in_fen = 0;
-    for (size_t rank = 0; rank < 8; ++rank) {
-      const auto current_rank = fenRanks[rank];
-      position_in_fen = 0;
-      for (size_t file = 0; file < 8; ++file, ++position_in_fen) {
-        char curr = current_rank[position_in_fen];
-        if (curr >= '1' && curr <= '8') {
-          int squaresToSkip = curr - '0';
-          file += static_cast<std::size_t>(squaresToSkip - 1);
-        } else {
-          // Set piece at current file and rank. Our rank is zero indexed, but
-          // first rank in fen is rank 8
-          if (!set_piece_at(file, 7 - rank, curr))
-            return false;
+  // Computes the Zobrist key of the current position from scratch
+  uint64_t compute_key() const {
+    uint64_t new_key = castling_key() ^ en_passant_key();
+    if (active_colour == Colour::Black)
+      new_key ^= zobrist::keys.side;
+
+    for (auto colour : {Colour::White, Colour::Black}) {
+      for (auto piece : get_all_pieces()) {
+        auto bitboard = get_bitboard(piece, colour);
+        while (bitboard) {
+          new_key ^=
+              zobrist::piece_key(colour, piece, std::countr_zero(bitboard));
+          bitboard &= bitboard - 1;
         }
       }
     }
-
-    return true;
+    return new_key;
   }
 
   bool set_piece_at(size_t file, size_t rank, char piece) {
@@ -331,122 +815,203 @@ private:
     return true;
   }
 
-  std::optional<unsigned int> get_pinned_in_dir(Direction dir) const {
-    using enum Direction;
+  void add_pawn_moves(std::vector<Move> &moves, int from, int to,
+                      bool capture) const {
+    const auto flag = capture ? Move::Flags::Capture : Move::Flags::None;
+    const bool promotion = (to < 8) || (to > 55);
+    if (promotion) {
+      for (auto promotion_flag :
+           {Move::Flags::PromotionQueen, Move::Flags::PromotionRook,
+            Move::Flags::PromotionBishop, Move::Flags::PromotionKnight}) {
+        const auto flags =
+            capture ? static_cast<Move::Flags>(promotion_flag | flag)
+                    : promotion_flag;
+        moves.push_back(Move{from, to, Piece::Pawn, active_colour, flags});
+      }
+    } else {
+      moves.push_back(Move{from, to, Piece::Pawn, active_colour, flag});
+    }
+  }
 
-    const auto occ_by_own = pawns[active_colour] | rooks[active_colour] |
-                            knights[active_colour] | bishops[active_colour] |
-                            queens[active_colour];
-    const auto king_pos = std::countr_zero(king[active_colour]);
+  void generate_pawn_moves(std::vector<Move> &moves) const {
+    const auto occ_by_other = occupied_by(get_other_colour(active_colour));
+    const auto occ = get_occupied();
 
-    const int ray_dir = static_cast<int>(dir);
+    const int direction = active_colour == Colour::White ? -1 : 1;
+    const int first_row_start = (active_colour == Colour::White) ? 48 : 8;
+    const int first_row_end = (active_colour == Colour::White) ? 55 : 15;
 
-    // Compute ray starting from king position
-    uint64_t ray = 0;
-    {
-      int curr = king_pos + ray_dir;
-      while (true) {
-        set_bit(&ray, curr);
-        int next_curr = curr + ray_dir;
+    auto rem_pawns = this->pawns[active_colour];
 
-        if (not is_inside_chessboard(curr) or distance(curr, next_curr) > 1)
-          break;
-        curr = next_curr;
-      }
-    }
+    while (rem_pawns) {
+      const auto from = std::countr_zero(rem_pawns);
 
-    if (auto pieces_on_ray = ray & occ_by_own) {
-      // There is at least one of our pieces on the ray, check if it is
-      // actually pinned
-      const auto other_colour = get_other_colour(active_colour);
-
-      uint64_t attackers = queens[other_colour];
-      if (dir == North || dir == South || dir == East || dir == West)
-        attackers |= rooks[other_colour];
-      else if (dir == NorthEast || dir == NorthWest || dir == SouthEast ||
-               dir == SouthWest)
-        attackers |= bishops[other_colour];
-
-      if (attackers & ray) {
-        // Get position of the first piece on the ray.
-        const auto piece_on_ray = 63 - std::countl_zero(pieces_on_ray);
-
-        // We already know that there is an attacker on the ray.
-        // We still have to check if one of our own pieces or a non-attacking
-        // piece blocks the pin.
-        bool blocked = false;
-
-        const auto occ_by_other = occupied_by(other_colour);
-        const auto non_attackers = occ_by_other & ~attackers;
-        const auto blockers = non_attackers | occ_by_own;
-
-        {
-          int curr = piece_on_ray + ray_dir;
-          while (not bit_is_set(attackers, curr)) { // follow ray until attacker
-            if (bit_is_set(blockers, curr))
-              blocked = true;
-            curr += ray_dir;
-          }
-        }
+      int to = from + direction * 8;
+      if (not bit_is_set(occ, static_cast<std::uint8_t>(to))) {
+        add_pawn_moves(moves, from, to, false);
+
+        const int to_two_steps = to + direction * 8;
+        if (first_row_start <= from && from <= first_row_end &&
+            not bit_is_set(occ, static_cast<std::uint8_t>(to_two_steps)))
+          moves.push_back(
+              Move{from, to_two_steps, Piece::Pawn, active_colour});
+      }
 
-        /* Since `piece_on_ray` is not necessarily the piece closest to the
-           king, we also have to follow the ray in the other direction and check
-           for blockers. */
-        {
-          int curr = piece_on_ray - ray_dir;
-          // follow ray until we reach king
-          while (not bit_is_set(king[active_colour], curr)) {
-            if (bit_is_set(blockers, curr))
-              blocked = true;
-            curr -= ray_dir;
-          }
-        }
+      auto targets = pawn_attacks(active_colour, 1UL << from);
+      if (en_passant_square != NO_EN_PASSANT &&
+          (targets & (1UL << en_passant_square)))
+        moves.push_back(Move{from, en_passant_square, Piece::Pawn,
+                             active_colour, Move::Flags::Capture});
 
-        if (not blocked) {
-          // We found a pinned piece, add it to the map
-          return piece_on_ray;
-        }
+      targets &= occ_by_other;
+      while (targets) {
+        add_pawn_moves(moves, from, std::countr_zero(targets), true);
+        targets &= targets - 1;
       }
+
+      // We are done considering the current pawn, delete from temp bitboard
+      rem_pawns &= ~(1UL << static_cast<uint8_t>(from));
     }
-    return {};
   }
 
-  void generate_pawn_moves(
-      std::vector<Move> &moves,
-      [[maybe_unused]] const std::unordered_map<unsigned int, Direction>
-          &pinned_positions) const {
+  void generate_piece_moves(std::vector<Move> &moves) const {
     const auto occ_by_own = occupied_by(active_colour);
     const auto occ_by_other = occupied_by(get_other_colour(active_colour));
     const auto occ = occ_by_own | occ_by_other;
 
-    const int direction = active_colour == Colour::White ? -1 : 1;
+    for (auto piece : get_all_pieces()) {
+      if (piece == Piece::Pawn)
+        continue;
 
-    auto rem_pawns = this->pawns[active_colour];
-    
-    while (rem_pawns) {
-      const auto from = std::countr_zero(rem_pawns);
+      auto rem_pieces = get_bitboard(piece, active_colour);
+      while (rem_pieces) {
+        const auto from = std::countr_zero(rem_pieces);
+        const auto sq = static_cast<std::size_t>(from);
 
-      int to = from + direction * 8;
-      if (not bit_is_set(occ, to)) {
-        /* Check if moving to last rank (-> promotion). We check this by moving
-         * another step forward and see if we land outside the board. */
-        if (not is_inside_chessboard(to + direction * 8)) {
-          moves.push_back(Move{from, to, Piece::Pawn, active_colour,
-                               Move::Flags::PromotionBishop});
-          moves.push_back(Move{from, to, Piece::Pawn, active_colour,
-                               Move::Flags::PromotionKnight});
-          moves.push_back(Move{from, to, Piece::Pawn, active_colour,
-                               Move::Flags::PromotionRook});
-          moves.push_back(Move{from, to, Piece::Pawn, active_colour,
-                               Move::Flags::PromotionQueen});
-        } else {
-          moves.push_back(Move{from, to, Piece::Pawn, active_colour});
+        uint64_t targets = 0;
+        switch (piece) {
+        case Piece::Knight:
+          targets = knight_attack_board[sq];
+          break;
+        case Piece::Bishop:
+          targets = bishop_attacks(from, occ);
+          break;
+        case Piece::Rook:
+          targets = rook_attacks(from, occ);
+          break;
+        case Piece::Queen:
+          targets = bishop_attacks(from, occ) | rook_attacks(from, occ);
+          break;
+        case Piece::King:
+          targets = king_attack_board[sq];
+          break;
+        default:
+          __builtin_unreachable();
+        }
+        targets &= ~occ_by_own;
+
+        while (targets) {
+          const auto to = std::countr_zero(targets);
+          const auto flag = bit_is_set(occ_by_other, static_cast<uint8_t>(to))
+                                ? Move::Flags::Capture
+                                : Move::Flags::None;
+          moves.push_back(Move{from, to, piece, active_colour, flag});
+          targets &= targets - 1;
         }
+
+        rem_pieces &= rem_pieces - 1;
       }
+    }
+  }
 
-      // We are done considering the current pawn, delete from temp bitboard
-      rem_pawns &= ~(1UL << static_cast<uint8_t>(from));
+  /* Castling moves are only generated if the squares between king and rook
+     are empty and the king does not pass through an attacked square. Whether
+     the king lands on an attacked square is checked in is_legal(). */
+  void generate_castling_moves(std::vector<Move> &moves) const {
+    const bool white = active_colour == Colour::White;
+    const bool can_castle_kingside =
+        white ? white_can_castle_kingside : black_can_castle_kingside;
+    const bool can_castle_queenside =
+        white ? white_can_castle_queenside : black_can_castle_queenside;
+    if (not(can_castle_kingside || can_castle_queenside))
+      return;
+
+    const int king_from = white ? 60 : 4;
+    if (not bit_is_set(king[active_colour], static_cast<uint8_t>(king_from)))
+      return;
+
+    const auto occ = get_occupied();
+    const auto other_colour = get_other_colour(active_colour);
+    if (is_square_attacked(king_from, other_colour))
+      return;
+
+    const auto is_empty = [occ](int square) {
+      return not bit_is_set(occ, static_cast<uint8_t>(square));
+    };
+
+    if (can_castle_kingside &&
+        bit_is_set(rooks[active_colour],
+                   static_cast<uint8_t>(king_from + 3)) &&
+        is_empty(king_from + 1) && is_empty(king_from + 2) &&
+        not is_square_attacked(king_from + 1, other_colour))
+      moves.push_back(Move{king_from, king_from + 2, Piece::King, active_colour});
+
+    if (can_castle_queenside &&
+        bit_is_set(rooks[active_colour],
+                   static_cast<uint8_t>(king_from - 4)) &&
+        is_empty(king_from - 1) && is_empty(king_from - 2) &&
+        is_empty(king_from - 3) &&
+        not is_square_attacked(king_from - 1, other_colour))
+      moves.push_back(Move{king_from, king_from - 2, Piece::King, active_colour});
+  }
+
+  /* Checks that the position is one the move generator can handle: each side
+     has exactly one king, no pawn stands on the first or last rank, the side
+     that just moved has not left its king in check, and an en passant square
+     is behind a pawn of that side which was just pushed by two squares (from
+     its now empty starting square). */
+  bool is_valid() const {
+    constexpr uint64_t back_ranks = 0xFF000000000000FFUL;
+    if (std::popcount(king[Colour::White]) != 1 ||
+        std::popcount(king[Colour::Black]) != 1 ||
+        ((pawns[Colour::White] | pawns[Colour::Black]) & back_ranks) ||
+        is_square_attacked(
+            std::countr_zero(king[get_other_colour(active_colour)]),
+            active_colour))
+      return false;
+
+    if (en_passant_square == NO_EN_PASSANT)
+      return true;
+    const bool white = active_colour == Colour::White;
+    const auto square = static_cast<std::uint8_t>(en_passant_square);
+    const auto pushed = static_cast<std::uint8_t>(white ? square + 8
+                                                        : square - 8);
+    const auto start = static_cast<std::uint8_t>(white ? square - 8
+                                                       : square + 8);
+    const auto occupied = get_occupied();
+    return bit_is_set(pawns[get_other_colour(active_colour)], pushed) &&
+           not bit_is_set(occupied, square) && not bit_is_set(occupied, start);
+  }
+
+  // Checks if the pseudo-legal move `move` leaves our king in check
+  bool is_legal(const Move &move) const {
+    const auto from = static_cast<int>(move.get_from());
+    const auto to = static_cast<int>(move.get_to());
+    const auto them = get_other_colour(active_colour);
+
+    auto occ = (get_occupied() & ~(1UL << from)) | (1UL << to);
+    auto captured = 1UL << to;
+    if (move.get_piece() == Piece::Pawn && to == en_passant_square) {
+      const int captured_square =
+          active_colour == Colour::White ? to + 8 : to - 8;
+      occ &= ~(1UL << captured_square);
+      captured = 1UL << captured_square;
     }
+
+    const int king_square = move.get_piece() == Piece::King
+                                ? to
+                                : std::countr_zero(king[active_colour]);
+    return not(attackers_to(king_square, occ) & occupied_by(them) & ~captured);
   }
 };
 
@@ -9,6 +9,7 @@
 #include <cstdint>
 #include <iostream>
 #include <ostream>
+#include <string>
 #include <type_traits>
 
 namespace mcc {
@@ -59,6 +60,8 @@ public:
     PromotionQueen = 32
   };
 
+  Move() = default;
+
   Move(int from, int to, Piece piece, Colour colour, Flags flags = Flags::None)
       : data{(static_cast<uint32_t>(colour) << colour_shift) |
              (static_cast<uint32_t>(piece) << piece_shift) |
@@ -93,6 +96,40 @@ public:
 
   bool is_capture() const { return (data & set_bits<1>()); }
 
+  bool is_promotion() const { return (data & set_bits<2, 3, 4, 5>()); }
+
+  // Returns the piece the pawn is promoted to. Only valid if is_promotion().
+  Piece get_promotion_piece() const {
+    if (data & Flags::PromotionQueen)
+      return Piece::Queen;
+    if (data & Flags::PromotionRook)
+      return Piece::Rook;
+    if (data & Flags::PromotionBishop)
+      return Piece::Bishop;
+    return Piece::Knight;
+  }
+
+  // Returns the move in the notation of the UCI protocol, eg. "e2e4", "e7e8q"
+  std::string to_uci() const {
+    auto uci = from_64_to_algebraic(static_cast<std::uint8_t>(get_from())) +
+               from_64_to_algebraic(static_cast<std::uint8_t>(get_to()));
+    if (is_promotion()) {
+      switch (get_promotion_piece()) {
+      case Piece::Queen:
+        return uci + 'q';
+      case Piece::Rook:
+        return uci + 'r';
+      case Piece::Bishop:
+        return uci + 'b';
+      default:
+        return uci + 'n';
+      }
+    }
+    return uci;
+  }
+
+  bool operator==(const Move &other) const = default;
+
   friend std::ostream &operator<<(std::ostream &out, const Move &m) {
     const auto from_algebraic = from_64_to_algebraic(m.get_from());
     const auto to_algebraic = from_64_to_algebraic(m.get_to());
@@ -113,7 +150,7 @@ public:
   }
 
 private:
-  uint32_t data;
+  uint32_t data = 0;
 };
 
 } // namespace mcc
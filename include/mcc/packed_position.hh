@@ -0,0 +1,262 @@
+#pragma once
+
+#include "mcc/common/colour.hh"
+#include "mcc/common/piece.hh"
+#include "mcc/mapped_file.hh"
+#include "mcc/mcc.hh"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <utility>
+#include <stdexcept>
+#include <vector>
+
+namespace mcc {
+enum class GameResult : std::int8_t {
+  BlackWin = -1,
+  Draw = 0,
+  WhiteWin = 1,
+  Unknown = -128
+};
+
+/*
+  A position packed into 32 bytes, optionally annotated with a score and the
+  result of the game it was taken from. The layout is
+
+    | Occupancy (64 bits) | Pieces (32 x 4 bits) | State (16 bits) |
+    | Full moves (16 bits) | Score (16 bits) | Result (8 bits) | Unused (8) |
+
+  Occupancy is the bitboard of all occupied squares. For every set bit (in
+  ascending square order) the pieces array contains a 4 bit code
+    colour << 3 | piece_index(piece)
+  with the first piece in the low nibble of pieces[0]. This limits the
+  format to positions with at most 32 pieces.
+
+  The state is structured as follows:
+  | Half moves (7 bits) | En passant file + 1 (4 bits) | Castling (4 bits) |
+  | Colour (1 bit) |
+  where castling uses the same mask as zobrist::castling_index(), an en
+  passant value of zero means no en passant square and the half move clock
+  saturates at 127.
+
+  Files are a plain sequence of these records in native (little-endian)
+  byte order, so they can simply be concatenated.
+ */
+struct PackedPosition {
+  static constexpr std::int16_t NO_SCORE = INT16_MIN;
+
+  std::uint64_t occupied = 0;
+  std::array<std::uint8_t, 16> pieces = {};
+  std::uint16_t state = 0;
+  std::uint16_t full_moves = 0;
+  std::int16_t score = NO_SCORE; // From White's point of view
+  GameResult result = GameResult::Unknown;
+  std::uint8_t unused = 0;
+
+  /* Packs the given board. Throws an exception if there are more than 32
+     pieces on the board. */
+  static PackedPosition pack(const mcc &board,
+                             std::int16_t score = NO_SCORE,
+                             GameResult result = GameResult::Unknown) {
+    PackedPosition packed;
+    packed.occupied = board.get_occupied();
+    if (std::popcount(packed.occupied) > 32)
+      throw std::invalid_argument(
+          "[mcc::PackedPosition::pack] More than 32 pieces on the board.");
+
+    std::size_t index = 0;
+    auto remaining = packed.occupied;
+    while (remaining) {
+      const int square = std::countr_zero(remaining);
+      const auto code = piece_code(board, square);
+      packed.pieces[index / 2] |=
+          static_cast<std::uint8_t>(code << (4 * (index % 2)));
+      ++index;
+      remaining &= remaining - 1;
+    }
+
+    const unsigned int en_passant =
+        board.en_passant_square == NO_EN_PASSANT
+            ? 0U
+            : static_cast<unsigned int>(board.en_passant_square % 8) + 1;
+    const auto castling = zobrist::castling_index(
+        board.white_can_castle_kingside, board.white_can_castle_queenside,
+        board.black_can_castle_kingside, board.black_can_castle_queenside);
+    const auto half_moves = std::min(board.half_moves, 127U);
+
+    packed.state = static_cast<std::uint16_t>(
+        static_cast<unsigned int>(board.active_colour) | (castling << 1) |
+        (en_passant << 5) | (half_moves << 9));
+    packed.full_moves = static_cast<std::uint16_t>(board.full_moves);
+    packed.score = score;
+    packed.result = result;
+    return packed;
+  }
+
+  /* Sets up `board` with the packed position, clearing its move history.
+     Records are read from files and may be corrupt, so the piece codes,
+     castling rights and en passant file are checked, as well as the position
+     itself (see mcc::load_from_fen()). Returns false if the record is
+     invalid, the board is left in an unspecified state then. */
+  [[nodiscard]] bool unpack(mcc &board) const {
+    for (auto *bitboard :
+         {board.pawns, board.knights, board.bishops, board.rooks, board.queens,
+          board.king})
+      bitboard[Colour::White] = bitboard[Colour::Black] = 0;
+    board.history.clear();
+    board.plies_since_null = 0;
+
+    if (std::popcount(occupied) > 32)
+      return false;
+    std::size_t index = 0;
+    auto remaining = occupied;
+    while (remaining) {
+      const int square = std::countr_zero(remaining);
+      const unsigned int code = (pieces[index / 2] >> (4 * (index % 2))) & 0xf;
+      if ((code & 0x7) > 5)
+        return false;
+      const auto colour = static_cast<Colour>(code >> 3);
+      const auto piece = static_cast<Piece>(1U << (code & 0x7));
+      mcc::bitboard_of(board, piece)[colour] |= 1UL << square;
+      ++index;
+      remaining &= remaining - 1;
+    }
+
+    board.active_colour = static_cast<Colour>(state & 0x1);
+    board.white_can_castle_kingside = state & (1U << 1);
+    board.white_can_castle_queenside = state & (1U << 2);
+    board.black_can_castle_kingside = state & (1U << 3);
+    board.black_can_castle_queenside = state & (1U << 4);
+
+    // Castling rights need the king and rook on their starting squares
+    constexpr std::array<std::pair<int, int>, 4> castling_squares = {
+        {{60, 63}, {60, 56}, {4, 7}, {4, 0}}};
+    for (unsigned int i = 0; i < 4; ++i) {
+      const auto colour = i < 2 ? Colour::White : Colour::Black;
+      const auto [king_square, rook_square] = castling_squares[i];
+      if ((state & (1U << (i + 1))) &&
+          not((board.king[colour] & (1UL << king_square)) &&
+              (board.rooks[colour] & (1UL << rook_square))))
+        return false;
+    }
+
+    const unsigned int en_passant = (state >> 5) & 0xf;
+    if (en_passant > 8)
+      return false;
+    if (en_passant == 0)
+      board.en_passant_square = NO_EN_PASSANT;
+    else
+      board.en_passant_square =
+          (board.active_colour == Colour::White ? 16 : 40) +
+          static_cast<int>(en_passant) - 1;
+
+    board.half_moves = static_cast<unsigned int>(state >> 9);
+    board.full_moves = full_moves;
+    if (not board.is_valid())
+      return false;
+    board.key = board.compute_key();
+    return true;
+  }
+
+private:
+  static unsigned int piece_code(const mcc &board, int square) {
+    for (auto colour : {Colour::White, Colour::Black}) {
+      for (auto piece : get_all_pieces()) {
+        if (board.get_bitboard(piece, colour) & (1UL << square))
+          return (static_cast<unsigned int>(colour) << 3) |
+                 static_cast<unsigned int>(piece_index(piece));
+      }
+    }
+    __builtin_unreachable();
+  }
+};
+
+static_assert(sizeof(PackedPosition) == 32);
+static_assert(std::endian::native == std::endian::little,
+              "The packed position format is little-endian");
+
+/* Writes packed positions to a file. Records are collected in a buffer and
+   written in large blocks. The buffer is flushed when it is full, when
+   flush() is called and on destruction. */
+class PackedPositionWriter {
+public:
+  explicit PackedPositionWriter(const std::filesystem::path &path,
+                                std::size_t buffer_size = 1 << 16)
+      : file{path, std::ios::binary | std::ios::trunc} {
+    if (not file)
+      throw std::runtime_error(
+          "[mcc::PackedPositionWriter] Cannot open file " + path.string());
+    buffer.reserve(buffer_size);
+  }
+
+  PackedPositionWriter(const PackedPositionWriter &) = delete;
+  PackedPositionWriter &operator=(const PackedPositionWriter &) = delete;
+
+  ~PackedPositionWriter() {
+    try {
+      flush();
+    } catch (...) {
+    }
+  }
+
+  void write(const PackedPosition &position) {
+    buffer.push_back(position);
+    if (buffer.size() == buffer.capacity())
+      flush();
+  }
+
+  void write(const mcc &board, std::int16_t score = PackedPosition::NO_SCORE,
+             GameResult result = GameResult::Unknown) {
+    write(PackedPosition::pack(board, score, result));
+  }
+
+  void flush() {
+    file.write(reinterpret_cast<const char *>(buffer.data()),
+               static_cast<std::streamsize>(buffer.size() *
+                                            sizeof(PackedPosition)));
+    file.flush();
+    buffer.clear();
+    if (not file)
+      throw std::runtime_error(
+          "[mcc::PackedPositionWriter] Writing to file failed.");
+  }
+
+private:
+  std::ofstream file;
+  std::vector<PackedPosition> buffer;
+};
+
+/* Gives random access to the records of a packed position file. The file is
+   memory-mapped, records are read directly from the mapping without any
+   copying or parsing. */
+class PackedPositionReader {
+public:
+  explicit PackedPositionReader(const std::filesystem::path &path)
+      : file{path} {
+    if (file.get_size() % sizeof(PackedPosition) != 0)
+      throw std::runtime_error("[mcc::PackedPositionReader] Size of file " +
+                               path.string() +
+                               " is not a multiple of the record size.");
+    file.advise_sequential();
+  }
+
+  std::span<const PackedPosition> records() const {
+    return {reinterpret_cast<const PackedPosition *>(file.data()),
+            file.get_size() / sizeof(PackedPosition)};
+  }
+
+  std::size_t size() const { return records().size(); }
+  const PackedPosition &operator[](std::size_t i) const { return records()[i]; }
+  auto begin() const { return records().begin(); }
+  auto end() const { return records().end(); }
+
+private:
+  MappedFile file;
+};
+} // namespace mcc
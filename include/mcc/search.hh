@@ -0,0 +1,494 @@
+#pragma once
+
+#include "mcc/compact_move.hh"
+#include "mcc/eval.hh"
+#include "mcc/mcc.hh"
+#include "mcc/move.hh"
+#include "mcc/stats.hh"
+#include "mcc/syzygy.hh"
+#include "mcc/transposition_table.hh"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace mcc {
+constexpr int MAX_PLY = 128;
+constexpr int INFINITE_SCORE = 32001;
+constexpr int MATE_SCORE = 32000;
+// Scores with an absolute value above this bound are mate scores
+constexpr int MATE_BOUND = MATE_SCORE - MAX_PLY;
+// Score of a tablebase win at the root, and the bound above which scores are
+// tablebase wins (or mates)
+constexpr int TB_WIN_SCORE = MATE_BOUND - 1;
+constexpr int TB_WIN_BOUND = TB_WIN_SCORE - MAX_PLY;
+
+/* Switches for the selective parts of the search. Everything is enabled by
+   default, disabling a technique allows to measure its effect on the number
+   of nodes needed to reach a given depth. */
+struct SearchOptions {
+  bool null_move_pruning = true;
+  bool late_move_reductions = true;
+  bool futility_pruning = true;
+  bool reverse_futility_pruning = true;
+  bool late_move_pruning = true;
+  bool razoring = true;
+  bool upcoming_repetition_detection = true;
+
+  // Tablebases are probed in the search for positions with at most
+  // `syzygy_probe_limit` pieces, at nodes with at least `syzygy_probe_depth`
+  // remaining depth if the position has exactly that many pieces
+  int syzygy_probe_depth = 1;
+  int syzygy_probe_limit = 7;
+  // Whether wins that are draws under the 50-move rule count as draws
+  bool syzygy_50_move_rule = true;
+};
+
+struct SearchResult {
+  std::vector<Move> pv; // Principal variation, pv.front() is the best move
+  int score = 0;        // From the point of view of the side to move
+  int depth = 0;
+  std::size_t nodes = 0;
+  std::size_t tb_hits = 0; // Successful tablebase probes
+};
+
+/*
+  Alpha-beta search (in its negamax formulation) with a quiescence search at
+  the leaves. On top of plain alpha-beta, the following selective techniques
+  are used in non-PV nodes when not in check:
+    - Reverse futility pruning: return if the static evaluation exceeds beta
+      by a depth dependent margin.
+    - Razoring: drop into quiescence search if the static evaluation is far
+      below alpha.
+    - Null move pruning: give the opponent a free move and search with reduced
+      depth. Disabled if the side to move has only pawns left (zugzwang).
+    - Futility and late move pruning: skip quiet moves close to the leaves if
+      the static evaluation is far below alpha or if many quiet moves have
+      already been searched.
+  Results are stored in a transposition table, which is kept between searches
+  (see clear()). Its entries cut off non-PV nodes and provide the first move
+  to try. Additionally, late quiet moves are searched with a reduced depth
+  (LMR) and re-searched with full depth if they unexpectedly raise alpha.
+
+  If tablebases are set, the moves at the root are restricted to those that
+  preserve the tablebase result, and positions with few enough pieces are
+  scored with the WDL tables as soon as the last capture or pawn move was
+  made (the tables ignore castling, so only without castling rights).
+ */
+class Searcher {
+public:
+  explicit Searcher(SearchOptions search_options = {},
+                    std::size_t hash_megabytes = 16)
+      : options{search_options}, tt{hash_megabytes} {}
+
+  // Forgets everything learned in previous searches
+  void clear() { tt.clear(); }
+
+  // Sets the tablebases to probe, nullptr disables probing. The tablebases
+  // must outlive the searcher.
+  void set_tablebases(const syzygy::Tablebases *syzygy_tablebases) {
+    tablebases = syzygy_tablebases;
+  }
+
+  /* Searches `board` with iterative deepening up to `depth` plies. If
+     `max_nodes` is not zero, the search stops once that many nodes have been
+     searched and the result of the last completed iteration is returned
+     (the first iteration always completes). The depth is limited to
+     MAX_PLY - 1, which also keeps it in the range of the depth stored in the
+     transposition table. If statistics are enabled (see stats.hh), the
+     counts of the search are written to stderr at the end. */
+  SearchResult search(mcc &board, int depth, std::size_t max_nodes = 0) {
+    const auto stats_before = stats::local_totals();
+    depth = std::min(depth, MAX_PLY - 1);
+    SearchResult result;
+    nodes = 0;
+    tb_hits = 0;
+    node_limit = 0;
+    stopped = false;
+    killers = {};
+
+    root_moves.clear();
+    if (tablebases && board.get_castling_rights() == 0 &&
+        std::popcount(board.get_occupied()) <= tb_piece_limit())
+      root_moves = tablebases->filter_root_moves(board,
+                                                 options.syzygy_50_move_rule);
+    if (not root_moves.empty()) {
+      ++tb_hits;
+      stats::add(stats::TBHits);
+    }
+
+    for (int current_depth = 1; current_depth <= depth; ++current_depth) {
+      root_move = result.pv.empty() ? Move{} : result.pv.front();
+
+      const int score = negamax(board, current_depth, 0, -INFINITE_SCORE,
+                                INFINITE_SCORE, true);
+      if (stopped)
+        break;
+      node_limit = max_nodes;
+
+      result.score = score;
+      result.depth = current_depth;
+      result.pv.assign(pv_table[0].begin(), pv_table[0].begin() + pv_length[0]);
+    }
+
+    result.nodes = nodes;
+    result.tb_hits = tb_hits;
+    if constexpr (stats::enabled)
+      stats::print_info(std::cerr, stats::difference(stats::local_totals(),
+                                                     stats_before));
+    return result;
+  }
+
+private:
+  struct ScoredMove {
+    Move move;
+    int score;
+  };
+
+  int negamax(mcc &board, int depth, int ply, int alpha, int beta,
+              bool allow_null) {
+    const auto uply = static_cast<std::size_t>(ply);
+    pv_length[uply] = uply;
+
+    if (ply > 0) {
+      if (board.is_draw())
+        return 0;
+
+      // If the side to move can repeat a position, it can at least draw
+      if (options.upcoming_repetition_detection && alpha < 0 &&
+          board.has_upcoming_repetition(ply)) {
+        alpha = 0;
+        if (alpha >= beta)
+          return alpha;
+      }
+    }
+
+    if (depth <= 0)
+      return quiescence(board, ply, alpha, beta);
+
+    ++nodes;
+    stats::add(stats::Nodes);
+    if (node_limit && nodes >= node_limit) {
+      stopped = true;
+      return 0;
+    }
+    if (ply >= MAX_PLY - 1)
+      return evaluate(board);
+
+    const bool pv_node = beta - alpha > 1;
+    const int original_alpha = alpha;
+
+    const auto *entry = tt.probe(board.get_key());
+    const auto tt_move = entry ? entry->move : CompactMove{};
+    stats::add(stats::TTProbes);
+    stats::add(stats::TTHits, entry ? 1 : 0);
+    if (entry && not pv_node && entry->depth >= depth) {
+      const int score = score_from_tt(entry->score, ply);
+      if (entry->bound() == Bound::Exact ||
+          (entry->bound() == Bound::Lower && score >= beta) ||
+          (entry->bound() == Bound::Upper && score <= alpha)) {
+        stats::add(stats::TTCutoffs);
+        return score;
+      }
+    }
+
+    if (ply > 0 && tablebases) {
+      const int pieces = std::popcount(board.get_occupied());
+      const int limit = tb_piece_limit();
+      if (pieces <= limit &&
+          (pieces < limit || depth >= options.syzygy_probe_depth) &&
+          board.get_half_moves() == 0 && board.get_castling_rights() == 0) {
+        syzygy::ProbeState state = syzygy::ProbeState::Ok;
+        const auto wdl = tablebases->probe_wdl(board, state);
+        if (state != syzygy::ProbeState::Fail) {
+          ++tb_hits;
+          stats::add(stats::TBHits);
+
+          // Cursed wins and blessed losses are scored close to a draw
+          const int draw_score = options.syzygy_50_move_rule ? 1 : 0;
+          const int score = wdl < -draw_score  ? -TB_WIN_SCORE + ply
+                            : wdl > draw_score ? TB_WIN_SCORE - ply
+                                               : 2 * wdl * draw_score;
+          const auto bound = wdl < -draw_score  ? Bound::Upper
+                             : wdl > draw_score ? Bound::Lower
+                                                : Bound::Exact;
+          if (bound == Bound::Exact ||
+              (bound == Bound::Lower ? score >= beta : score <= alpha)) {
+            tt.store(board.get_key(), CompactMove{}, score_to_tt(score, ply),
+                     std::min(MAX_PLY - 1, depth + 6), bound);
+            return score;
+          }
+        }
+      }
+    }
+
+    const bool in_check = board.in_check();
+    const int static_eval = evaluate(board);
+
+    if (not pv_node && not in_check) {
+      if (options.reverse_futility_pruning && depth <= 6 &&
+          std::abs(beta) < MATE_BOUND && static_eval - 100 * depth >= beta)
+        return static_eval;
+
+      if (options.razoring && depth <= 2 &&
+          static_eval + 300 * depth < alpha) {
+        const int score = quiescence(board, ply, alpha, beta);
+        if (depth == 1 || score < alpha)
+          return score;
+      }
+
+      if (options.null_move_pruning && allow_null && depth >= 3 &&
+          static_eval >= beta &&
+          board.non_pawn_material(board.get_active_colour())) {
+        const int reduction = 3 + depth / 6;
+
+        board.make_null_move();
+        const int score = -negamax(board, depth - 1 - reduction, ply + 1,
+                                   -beta, -beta + 1, false);
+        board.unmake_move();
+
+        if (stopped)
+          return 0;
+        if (score >= beta)
+          return score >= MATE_BOUND ? beta : score;
+      }
+    }
+
+    auto legal_moves = board.generate_moves();
+    if (ply == 0 && not root_moves.empty())
+      std::erase_if(legal_moves, [this](const Move &move) {
+        return std::find(root_moves.begin(), root_moves.end(), move) ==
+               root_moves.end();
+      });
+    const auto moves = order_moves(board, legal_moves, ply, tt_move);
+    if (moves.empty())
+      return in_check ? -MATE_SCORE + ply : 0;
+
+    const bool can_prune = not pv_node && not in_check &&
+                           std::abs(alpha) < MATE_BOUND;
+    const int late_move_count = 3 + depth * depth;
+    const int futility_margin = 100 + 150 * depth;
+
+    int best_score = -INFINITE_SCORE;
+    Move best_move;
+    int moves_searched = 0;
+    int quiets_searched = 0;
+    for (const auto &[move, _] : moves) {
+      const bool quiet = not move.is_capture() && not move.is_promotion();
+
+      if (can_prune && quiet && moves_searched > 0 && depth <= 3) {
+        if (options.late_move_pruning && quiets_searched >= late_move_count)
+          continue;
+
+        if (options.futility_pruning && static_eval + futility_margin <= alpha)
+          continue;
+      }
+
+      board.make_move(move);
+
+      int score = 0;
+      if (moves_searched == 0) {
+        score = -negamax(board, depth - 1, ply + 1, -beta, -alpha, true);
+      } else {
+        int reduction = 0;
+        if (options.late_move_reductions && depth >= 3 &&
+            moves_searched >= 3 && quiet && not in_check &&
+            not board.in_check()) {
+          reduction = reduction_table[static_cast<std::size_t>(
+              std::min(depth, 63))][static_cast<std::size_t>(
+              std::min(moves_searched, 63))];
+          if (pv_node)
+            --reduction;
+          reduction = std::clamp(reduction, 0, depth - 2);
+        }
+
+        score = -negamax(board, depth - 1 - reduction, ply + 1, -alpha - 1,
+                         -alpha, true);
+        if (score > alpha && reduction > 0)
+          score = -negamax(board, depth - 1, ply + 1, -alpha - 1, -alpha,
+                           true);
+        if (score > alpha && score < beta)
+          score = -negamax(board, depth - 1, ply + 1, -beta, -alpha, true);
+      }
+
+      board.unmake_move();
+      if (stopped)
+        return 0;
+      ++moves_searched;
+      if (quiet)
+        ++quiets_searched;
+
+      if (score > best_score) {
+        best_score = score;
+        best_move = move;
+        if (score > alpha) {
+          alpha = score;
+          update_pv(uply, move);
+          if (score >= beta) {
+            stats::add(stats::BetaCutoffs);
+            stats::add(stats::FirstMoveCutoffs, moves_searched == 1 ? 1 : 0);
+            if (quiet)
+              store_killer(uply, CompactMove::from_move(move, board));
+            break;
+          }
+        }
+      }
+    }
+
+    const auto bound = best_score >= beta             ? Bound::Lower
+                       : best_score > original_alpha ? Bound::Exact
+                                                     : Bound::Upper;
+    tt.store(board.get_key(), CompactMove::from_move(best_move, board),
+             score_to_tt(best_score, ply), depth, bound);
+
+    return best_score;
+  }
+
+  int quiescence(mcc &board, int ply, int alpha, int beta) {
+    const auto uply = static_cast<std::size_t>(ply);
+    pv_length[uply] = uply;
+    ++nodes;
+    stats::add(stats::QNodes);
+
+    const int stand_pat = evaluate(board);
+    if (ply >= MAX_PLY - 1 || stand_pat >= beta)
+      return stand_pat;
+    alpha = std::max(alpha, stand_pat);
+
+    auto moves = board.generate_moves();
+    std::erase_if(moves, [](const Move &move) {
+      return not(move.is_capture() || move.is_promotion());
+    });
+
+    int best_score = stand_pat;
+    for (const auto &[move, _] : order_moves(board, moves, ply, {})) {
+      board.make_move(move);
+      const int score = -quiescence(board, ply + 1, -beta, -alpha);
+      board.unmake_move();
+
+      if (score > best_score) {
+        best_score = score;
+        if (score > alpha) {
+          alpha = score;
+          update_pv(uply, move);
+          if (score >= beta)
+            break;
+        }
+      }
+    }
+
+    return best_score;
+  }
+
+  /* Sorts the moves such that the move from the transposition table (and the
+     best move of the previous iteration at the root) comes first, followed
+     by captures and promotions (most valuable victim, least valuable
+     attacker first) and the killer moves. */
+  std::vector<ScoredMove> order_moves(const mcc &board,
+                                      const std::vector<Move> &moves,
+                                      int ply, CompactMove tt_move) const {
+    const auto uply = static_cast<std::size_t>(ply);
+
+    std::vector<ScoredMove> scored_moves;
+    scored_moves.reserve(moves.size());
+    for (const auto &move : moves) {
+      int score = 0;
+      if ((ply == 0 && move == root_move) ||
+          (tt_move && CompactMove::from_move(move, board) == tt_move)) {
+        score = 1'000'000;
+      } else if (move.is_capture() || move.is_promotion()) {
+        const auto victim = board.get_piece_on(static_cast<int>(move.get_to()));
+        score = 100'000 - piece_value(move.get_piece());
+        if (victim)
+          score += 10 * piece_value(*victim);
+        if (move.is_promotion())
+          score += piece_value(move.get_promotion_piece());
+      } else if (killers[uply][0]) {
+        const auto compact = CompactMove::from_move(move, board);
+        if (compact == killers[uply][0])
+          score = 90'000;
+        else if (compact == killers[uply][1])
+          score = 80'000;
+      }
+      scored_moves.push_back({move, score});
+    }
+
+    std::stable_sort(scored_moves.begin(), scored_moves.end(),
+                     [](const ScoredMove &a, const ScoredMove &b) {
+                       return a.score > b.score;
+                     });
+    return scored_moves;
+  }
+
+  // Mate and tablebase scores are stored relative to the current node in the
+  // table
+  static int score_to_tt(int score, int ply) {
+    if (score >= TB_WIN_BOUND)
+      return score + ply;
+    if (score <= -TB_WIN_BOUND)
+      return score - ply;
+    return score;
+  }
+
+  static int score_from_tt(int score, int ply) {
+    if (score >= TB_WIN_BOUND)
+      return score - ply;
+    if (score <= -TB_WIN_BOUND)
+      return score + ply;
+    return score;
+  }
+
+  // Largest number of pieces of positions that are probed
+  int tb_piece_limit() const {
+    return tablebases ? std::min(tablebases->get_max_pieces(),
+                                 options.syzygy_probe_limit)
+                      : 0;
+  }
+
+  void update_pv(std::size_t ply, const Move &move) {
+    pv_table[ply][ply] = move;
+    for (auto i = ply + 1; i < pv_length[ply + 1]; ++i)
+      pv_table[ply][i] = pv_table[ply + 1][i];
+    pv_length[ply] = std::max(pv_length[ply + 1], ply + 1);
+  }
+
+  void store_killer(std::size_t ply, CompactMove move) {
+    if (killers[ply][0] == move)
+      return;
+    killers[ply][1] = killers[ply][0];
+    killers[ply][0] = move;
+  }
+
+  // Late move reductions, indexed by depth and number of moves searched
+  static inline const auto reduction_table = []() {
+    std::array<std::array<int, 64>, 64> table = {};
+    for (std::size_t depth = 1; depth < 64; ++depth)
+      for (std::size_t moves = 1; moves < 64; ++moves)
+        table[depth][moves] = static_cast<int>(
+            0.75 + std::log(static_cast<double>(depth)) *
+                       std::log(static_cast<double>(moves)) / 2.25);
+    return table;
+  }();
+
+  SearchOptions options;
+  TranspositionTable tt;
+  std::size_t nodes = 0;
+  std::size_t tb_hits = 0;
+  std::size_t node_limit = 0; // Zero if unlimited
+  bool stopped = false;       // Set if the node limit was hit
+  Move root_move;
+
+  const syzygy::Tablebases *tablebases = nullptr;
+  std::vector<Move> root_moves; // Moves allowed by the tablebases
+
+  constexpr static auto max_ply = static_cast<std::size_t>(MAX_PLY);
+  std::array<std::array<CompactMove, 2>, max_ply> killers = {};
+  std::array<std::array<Move, max_ply>, max_ply> pv_table = {};
+  std::array<std::size_t, max_ply> pv_length = {};
+};
+} // namespace mcc
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "mcc/common/colour.hh"
+#include "mcc/common/piece.hh"
+#include "mcc/mcc.hh"
+#include "mcc/move.hh"
+#include "mcc/packed_position.hh"
+#include "mcc/polyglot_book.hh"
+#include "mcc/search.hh"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace mcc {
+struct SelfplayOptions {
+  int depth = 8;         // Search depth per move
+  std::size_t nodes = 0; // Node limit per move (zero for none)
+  int random_plies = 8;  // Random moves played from the opening position
+  int max_plies = 400;   // Longer games are adjudicated as draws
+  // A game is adjudicated as won if the score of one side stays above
+  // `resign_score` for `resign_plies` consecutive plies
+  int resign_score = 1000;
+  int resign_plies = 8;
+};
+
+struct SelfplayGame {
+  std::vector<PackedPosition> positions; // Annotated with score and result
+  GameResult result = GameResult::Unknown;
+  int plies = 0;
+};
+
+// Returns true if neither side can possibly mate: only kings and at most one
+// knight or bishop are left
+inline bool is_insufficient_material(const mcc &board) {
+  const auto minors = board.get_bitboard(Piece::Knight, Colour::White) |
+                      board.get_bitboard(Piece::Knight, Colour::Black) |
+                      board.get_bitboard(Piece::Bishop, Colour::White) |
+                      board.get_bitboard(Piece::Bishop, Colour::Black);
+  const auto kings = board.get_bitboard(Piece::King, Colour::White) |
+                     board.get_bitboard(Piece::King, Colour::Black);
+  return (board.get_occupied() & ~kings) == minors && std::popcount(minors) <= 1;
+}
+
+/* Plays one game of the engine against itself, starting from `board`. If a
+   book is given, book moves are played as long as the position is in the
+   book, followed by `options.random_plies` random moves. Every position in
+   which the side to move is not in check and the best move is quiet is
+   recorded with its search score (from White's point of view), positions
+   with mate or tablebase win scores are skipped. These are the positions whose static evaluation should match the
+   search, which is what evaluation tuning needs. Once the game is over, the
+   result is stored in all recorded positions. */
+template <typename Generator>
+SelfplayGame play_game(mcc board, Searcher &searcher,
+                       const SelfplayOptions &options, Generator &generator,
+                       const polyglot::Book *book = nullptr) {
+  SelfplayGame game;
+
+  for (int ply = 0; book && ply < options.max_plies; ++ply) {
+    const auto move = book->pick(board, generator);
+    if (not move)
+      break;
+    board.make_move(*move);
+  }
+
+  for (int ply = 0; ply < options.random_plies; ++ply) {
+    const auto moves = board.generate_moves();
+    if (moves.empty())
+      break;
+    std::uniform_int_distribution<std::size_t> pick(0, moves.size() - 1);
+    board.make_move(moves[pick(generator)]);
+  }
+
+  searcher.clear();
+  int winning_plies = 0; // Positive if White is winning, negative for Black
+  while (game.result == GameResult::Unknown) {
+    const auto white_to_move = board.get_active_colour() == Colour::White;
+
+    if (board.generate_moves().empty()) {
+      if (not board.in_check())
+        game.result = GameResult::Draw;
+      else
+        game.result = white_to_move ? GameResult::BlackWin : GameResult::WhiteWin;
+      break;
+    }
+    if (board.is_game_drawn() || is_insufficient_material(board) ||
+        game.plies >= options.max_plies) {
+      game.result = GameResult::Draw;
+      break;
+    }
+
+    const auto result = searcher.search(board, options.depth, options.nodes);
+    const auto &best_move = result.pv.front();
+    const int score = white_to_move ? result.score : -result.score;
+
+    if (not board.in_check() && not best_move.is_capture() &&
+        not best_move.is_promotion() && std::abs(score) < TB_WIN_BOUND)
+      game.positions.push_back(
+          PackedPosition::pack(board, static_cast<std::int16_t>(score)));
+
+    if (score >= options.resign_score)
+      winning_plies = std::max(winning_plies, 0) + 1;
+    else if (score <= -options.resign_score)
+      winning_plies = std::min(winning_plies, 0) - 1;
+    else
+      winning_plies = 0;
+    if (std::abs(winning_plies) >= options.resign_plies) {
+      game.result =
+          winning_plies > 0 ? GameResult::WhiteWin : GameResult::BlackWin;
+      break;
+    }
+
+    board.make_move(best_move);
+    ++game.plies;
+  }
+
+  for (auto &position : game.positions)
+    position.result = game.result;
+  return game;
+}
+} // namespace mcc
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mcc::stats {
+/*
+  Counters for profiling the hot paths of the engine. They are only collected
+  if the engine is compiled with MCC_STATS defined (cmake -DMCC_STATS=ON),
+  otherwise all functions in this file compile to nothing.
+
+  Every thread increments its own set of counters, padded to a cache line so
+  that threads never write to the same line. Since each counter has a single
+  writer, increments are plain relaxed loads and stores instead of atomic
+  read-modify-write operations. The counters of all threads are summed up on
+  demand by aggregate().
+ */
+#ifdef MCC_STATS
+constexpr bool enabled = true;
+#else
+constexpr bool enabled = false;
+#endif
+
+enum Counter : std::size_t {
+  Nodes,
+  QNodes,
+  TTProbes,
+  TTHits,
+  TTCutoffs,
+  BetaCutoffs,
+  FirstMoveCutoffs,
+  MovegenCalls,
+  MovesGenerated,
+  MovegenTime,
+  Evaluations,
+  EvalTime,
+  MakeMoves,
+  MakeMoveTime,
+  TBHits,
+  NumCounters
+};
+
+constexpr std::array<std::string_view, NumCounters> counter_names = {
+    "nodes",          "qnodes",       "tt_probes",  "tt_hits",
+    "tt_cutoffs",     "beta_cutoffs", "first_move_cutoffs",
+    "movegen_calls",  "moves_generated", "movegen_ns",
+    "evaluations",    "eval_ns",      "make_moves", "make_move_ns",
+    "tb_hits"};
+
+struct alignas(64) Counters {
+  std::array<std::atomic<std::uint64_t>, NumCounters> values = {};
+};
+
+// Sum of the counters of all threads
+using Totals = std::array<std::uint64_t, NumCounters>;
+
+class Registry {
+public:
+  // Creates the counters of the calling thread. Counters are never freed, so
+  // that the totals include threads that have already finished.
+  Counters &register_thread() {
+    std::lock_guard lock{mutex};
+    return *all_counters.emplace_back(std::make_unique<Counters>());
+  }
+
+  Totals aggregate() const {
+    std::lock_guard lock{mutex};
+    Totals totals = {};
+    for (const auto &counters : all_counters)
+      for (std::size_t i = 0; i < NumCounters; ++i)
+        totals[i] += counters->values[i].load(std::memory_order_relaxed);
+    return totals;
+  }
+
+  void reset() {
+    std::lock_guard lock{mutex};
+    for (auto &counters : all_counters)
+      for (auto &value : counters->values)
+        value.store(0, std::memory_order_relaxed);
+  }
+
+private:
+  mutable std::mutex mutex;
+  std::vector<std::unique_ptr<Counters>> all_counters;
+};
+
+inline Registry registry;
+
+inline Counters &local_counters() {
+  thread_local Counters &counters = registry.register_thread();
+  return counters;
+}
+
+inline void add([[maybe_unused]] Counter counter,
+                [[maybe_unused]] std::uint64_t amount = 1) {
+  if constexpr (enabled) {
+    auto &value = local_counters().values[counter];
+    value.store(value.load(std::memory_order_relaxed) + amount,
+                std::memory_order_relaxed);
+  }
+}
+
+inline Totals aggregate() {
+  if constexpr (enabled)
+    return registry.aggregate();
+  return {};
+}
+
+// The counters of the calling thread only
+inline Totals local_totals() {
+  Totals totals = {};
+  if constexpr (enabled) {
+    const auto &counters = local_counters();
+    for (std::size_t i = 0; i < NumCounters; ++i)
+      totals[i] = counters.values[i].load(std::memory_order_relaxed);
+  }
+  return totals;
+}
+
+// The counts between two snapshots taken with local_totals() or aggregate()
+inline Totals difference(const Totals &after, const Totals &before) {
+  Totals totals = {};
+  for (std::size_t i = 0; i < NumCounters; ++i)
+    totals[i] = after[i] - before[i];
+  return totals;
+}
+
+inline void reset() {
+  if constexpr (enabled)
+    registry.reset();
+}
+
+/* Increments the call counter and adds the time (in nanoseconds) between
+   construction and destruction to the time counter. Reading the clock costs
+   about as much as the functions that are timed (make_move, evaluate), so
+   only every timer_sample_interval-th call of a thread is timed, and its time
+   is counted for all calls of the interval. Empty if statistics are
+   disabled. */
+constexpr std::uint64_t timer_sample_interval = 64;
+
+#ifdef MCC_STATS
+class ScopedTimer {
+public:
+  ScopedTimer(Counter time_counter, Counter call_counter) : time{time_counter} {
+    auto &calls = local_counters().values[call_counter];
+    const auto count = calls.load(std::memory_order_relaxed);
+    calls.store(count + 1, std::memory_order_relaxed);
+    if (count % timer_sample_interval == 0) {
+      sampled = true;
+      start = std::chrono::steady_clock::now();
+    }
+  }
+
+  ScopedTimer(const ScopedTimer &) = delete;
+  ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+  ~ScopedTimer() {
+    if (not sampled)
+      return;
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    add(time, timer_sample_interval *
+                  static_cast<std::uint64_t>(
+                      std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          elapsed)
+                          .count()));
+  }
+
+private:
+  Counter time;
+  bool sampled = false;
+  std::chrono::steady_clock::time_point start;
+};
+#else
+class ScopedTimer {
+public:
+  ScopedTimer(Counter, Counter) {}
+};
+#endif
+
+// Formats the totals as a single line JSON object, including derived rates
+inline std::string to_json(const Totals &totals) {
+  std::ostringstream out;
+  out << "{";
+  for (std::size_t i = 0; i < NumCounters; ++i)
+    out << (i > 0 ? ", " : "") << "\"" << counter_names[i]
+        << "\": " << totals[i];
+
+  const auto ratio = [](std::uint64_t a, std::uint64_t b) {
+    return b > 0 ? static_cast<double>(a) / static_cast<double>(b) : 0.0;
+  };
+  out << ", \"tt_hit_rate\": " << ratio(totals[TTHits], totals[TTProbes])
+      << ", \"first_move_cutoff_rate\": "
+      << ratio(totals[FirstMoveCutoffs], totals[BetaCutoffs])
+      << ", \"moves_per_movegen\": "
+      << ratio(totals[MovesGenerated], totals[MovegenCalls]) << "}";
+  return out.str();
+}
+
+// Formats the totals as a UCI "info string" line (without a newline)
+inline std::string to_uci_info(const Totals &totals) {
+  std::ostringstream out;
+  out << "info string stats";
+  for (std::size_t i = 0; i < NumCounters; ++i)
+    out << " " << counter_names[i] << " " << totals[i];
+  if (totals[BetaCutoffs] > 0)
+    out << " first_move_cutoff_rate "
+        << static_cast<double>(totals[FirstMoveCutoffs]) /
+               static_cast<double>(totals[BetaCutoffs]);
+  return out.str();
+}
+
+// Writes the totals as a UCI "info string" line to `out`. Lines written by
+// different threads are not interleaved.
+inline void print_info(std::ostream &out, const Totals &totals) {
+  static std::mutex mutex;
+  std::lock_guard lock{mutex};
+  out << to_uci_info(totals) << std::endl;
+}
+} // namespace mcc::stats
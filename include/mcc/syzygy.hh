@@ -0,0 +1,1250 @@
+#pragma once
+
+#include "mcc/common/colour.hh"
+#include "mcc/common/piece.hh"
+#include "mcc/mapped_file.hh"
+#include "mcc/mcc.hh"
+#include "mcc/move.hh"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace mcc::syzygy {
+/*
+  Probing of Syzygy endgame tablebases (.rtbw files with win/draw/loss
+  information and .rtbz files with the distance to the next capture or pawn
+  move, "DTZ").
+
+  Tablebases(paths) only scans the given directories for table files, a file
+  is memory-mapped and its header parsed the first time a position with its
+  material is probed. Probing is thread safe.
+
+  The layout of the files (index encoding, Huffman compressed blocks, etc.)
+  follows the reference implementation of the format by Ronald de Man, as
+  used by most engines. Inside this file squares are numbered as in the
+  tablebases, ie. a1 = 0, h1 = 7, a8 = 56, which is the board numbering with
+  the ranks flipped (square ^ 56). Pieces are encoded as
+    Pawn = 1, Knight = 2, Bishop = 3, Rook = 4, Queen = 5, King = 6
+  plus 8 for Black.
+ */
+
+// Game theoretic values. Cursed wins and blessed losses are wins/losses that
+// are draws under the 50-move rule.
+enum WDLScore : int {
+  Loss = -2,
+  BlessedLoss = -1,
+  Draw = 0,
+  CursedWin = 1,
+  Win = 2
+};
+
+enum class ProbeState {
+  Fail,            // Table missing or corrupt
+  Ok,              // Probe successful
+  ChangeSideToMove, // DTZ table only stores the other side to move
+  ZeroingBestMove  // The best move is a capture or pawn move
+};
+
+// A root move with its tablebase rank, higher ranks are better
+struct RankedMove {
+  Move move;
+  int rank;
+};
+
+namespace detail {
+constexpr int max_table_pieces = 7;
+
+constexpr int file_of(int square) { return square & 7; }
+constexpr int rank_of(int square) { return square >> 3; }
+constexpr int flip_file(int square) { return square ^ 7; }
+constexpr int flip_rank(int square) { return square ^ 56; }
+// Negative below the a1-h8 diagonal, zero on it, positive above it
+constexpr int off_a1h8(int square) { return rank_of(square) - file_of(square); }
+
+constexpr auto idx = [](int i) { return static_cast<std::size_t>(i); };
+
+/* Tables used to map the pieces of a position to the index in a table. See
+   make_encoding() for the meaning of each table. */
+struct Encoding {
+  std::array<int, 64> map_pawns = {};
+  std::array<int, 64> map_b1h1h7 = {};
+  std::array<int, 64> map_a1d1d4 = {};
+  std::array<std::array<int, 64>, 10> map_kk = {};
+  std::array<std::array<int, 64>, 6> binomial = {};
+  std::array<std::array<int, 64>, 6> lead_pawn_idx = {};
+  std::array<std::array<int, 4>, 6> lead_pawns_size = {};
+};
+
+constexpr Encoding make_encoding() {
+  Encoding e;
+
+  // map_b1h1h7 maps squares below the a1-h8 diagonal to 0..27
+  int code = 0;
+  for (int s = 0; s < 64; ++s)
+    if (off_a1h8(s) < 0)
+      e.map_b1h1h7[idx(s)] = code++;
+
+  // map_a1d1d4 maps squares in the a1-d1-d4 triangle to 0..9, the squares on
+  // the diagonal come last
+  code = 0;
+  for (int s = 0; s <= 27; ++s)
+    if (off_a1h8(s) < 0 && file_of(s) <= 3)
+      e.map_a1d1d4[idx(s)] = code++;
+  for (int s = 0; s <= 27; ++s)
+    if (off_a1h8(s) == 0 && file_of(s) <= 3)
+      e.map_a1d1d4[idx(s)] = code++;
+
+  /* map_kk encodes the 462 legal placements of two kings where the first one
+     is in the a1-d1-d4 triangle. If the first king is on the diagonal, the
+     second one is not above it. Placements with both kings on the diagonal
+     come last. */
+  const auto adjacent_or_equal = [](int s1, int s2) {
+    const int df = file_of(s1) - file_of(s2);
+    const int dr = rank_of(s1) - rank_of(s2);
+    return df >= -1 && df <= 1 && dr >= -1 && dr <= 1;
+  };
+  std::array<std::array<int, 2>, 64> both_on_diagonal = {};
+  std::size_t num_both_on_diagonal = 0;
+  code = 0;
+  for (int i = 0; i < 10; ++i) {
+    for (int s1 = 0; s1 <= 27; ++s1) {
+      // b1 is mapped to 0 as well as the squares not in the triangle
+      if (e.map_a1d1d4[idx(s1)] != i || (i == 0 && s1 != 1))
+        continue;
+      for (int s2 = 0; s2 < 64; ++s2) {
+        if (adjacent_or_equal(s1, s2))
+          continue;
+        if (off_a1h8(s1) == 0 && off_a1h8(s2) > 0)
+          continue;
+        if (off_a1h8(s1) == 0 && off_a1h8(s2) == 0)
+          both_on_diagonal[num_both_on_diagonal++] = {i, s2};
+        else
+          e.map_kk[idx(i)][idx(s2)] = code++;
+      }
+    }
+  }
+  for (std::size_t i = 0; i < num_both_on_diagonal; ++i)
+    e.map_kk[idx(both_on_diagonal[i][0])][idx(both_on_diagonal[i][1])] =
+        code++;
+
+  // binomial[k][n] is the number of ways to choose k out of n elements
+  e.binomial[0][0] = 1;
+  for (int n = 1; n < 64; ++n)
+    for (int k = 0; k < 6 && k <= n; ++k)
+      e.binomial[idx(k)][idx(n)] =
+          (k > 0 ? e.binomial[idx(k - 1)][idx(n - 1)] : 0) +
+          (k < n ? e.binomial[idx(k)][idx(n - 1)] : 0);
+
+  /* map_pawns maps the squares a2-h7 to 0..47, such that the pawn with the
+     highest value is the leading pawn: the one closest to the edge and,
+     among those, the one with the lowest rank. lead_pawn_idx and
+     lead_pawns_size are used to encode the group of leading pawns, the
+     tables are split by the file of the leading pawn. */
+  int available_squares = 47;
+  for (int lead_pawns = 1; lead_pawns <= 5; ++lead_pawns) {
+    for (int f = 0; f < 4; ++f) {
+      int index = 0;
+      for (int r = 1; r <= 6; ++r) {
+        const int s = 8 * r + f;
+        if (lead_pawns == 1) {
+          e.map_pawns[idx(s)] = available_squares--;
+          e.map_pawns[idx(flip_file(s))] = available_squares--;
+        }
+        e.lead_pawn_idx[idx(lead_pawns)][idx(s)] = index;
+        index += e.binomial[idx(lead_pawns - 1)][idx(e.map_pawns[idx(s)])];
+      }
+      e.lead_pawns_size[idx(lead_pawns)][idx(f)] = index;
+    }
+  }
+
+  return e;
+}
+
+constexpr inline Encoding encoding = make_encoding();
+
+template <typename T> T read_little_endian(const uint8_t *data) {
+  T value = 0;
+  for (std::size_t i = 0; i < sizeof(T); ++i)
+    value = static_cast<T>(value | static_cast<T>(static_cast<T>(data[i])
+                                                  << (8 * i)));
+  return value;
+}
+
+template <typename T> T read_big_endian(const uint8_t *data) {
+  T value = 0;
+  for (std::size_t i = 0; i < sizeof(T); ++i)
+    value = static_cast<T>((value << 8) | data[i]);
+  return value;
+}
+
+enum TableFlags : uint8_t {
+  SideToMove = 1,
+  Mapped = 2,
+  WinPlies = 4,
+  LossPlies = 8,
+  Wide = 16,
+  SingleValue = 128
+};
+
+/* Decoding information of one sub-table. A table has one sub-table per side
+   to move (WDL tables of unsymmetric material only) and, with pawns, per file
+   a-d of the leading pawn. All pointers point into the mapped file. */
+struct PairsData {
+  uint8_t flags = 0;
+  std::size_t block_size = 0;   // Size of a compressed block in bytes
+  std::size_t span = 0;         // Values between two sparse index entries
+  std::size_t num_blocks = 0;
+  int max_sym_len = 0;          // Length of the Huffman codes in bits
+  int min_sym_len = 0;          // (the single value for SingleValue tables)
+  const uint8_t *lowest_sym = nullptr;   // Lowest symbol of each length
+  const uint8_t *btree = nullptr;        // Pairs of symbols, 3 bytes each
+  const uint8_t *block_length = nullptr; // Values per block minus one
+  std::size_t block_length_size = 0;
+  const uint8_t *sparse_index = nullptr; // Every span values: block, offset
+  std::size_t sparse_index_size = 0;
+  const uint8_t *data = nullptr;         // Compressed blocks
+  std::vector<uint64_t> base64;          // Lowest code of each length,
+                                         // left aligned to 64 bits
+  std::vector<uint8_t> symlen;           // Values per symbol minus one
+  std::array<int, max_table_pieces> pieces = {};
+  std::array<uint64_t, max_table_pieces + 1> group_idx = {};
+  std::array<int, max_table_pieces + 1> group_len = {};
+  std::array<std::size_t, 4> map_idx = {}; // DTZ only
+};
+
+inline int left_symbol(const uint8_t *btree, std::size_t sym) {
+  const auto *lr = btree + 3 * sym;
+  return ((lr[1] & 0xF) << 8) | lr[0];
+}
+
+inline int right_symbol(const uint8_t *btree, std::size_t sym) {
+  const auto *lr = btree + 3 * sym;
+  return (lr[2] << 4) | (lr[1] >> 4);
+}
+
+/* Returns the value stored at `index`. The values are compressed by
+   recursive pairing (each symbol stands for a pair of symbols) followed by a
+   canonical Huffman code. The sparse index gives the block and offset of
+   every span-th value, from there the block containing `index` is found
+   with the block lengths, then the symbols of the block are decoded until
+   the one containing the value is found and finally that symbol is expanded
+   into its pairs. */
+inline int decompress_pairs(const PairsData &d, uint64_t index) {
+  if (d.flags & SingleValue)
+    return d.min_sym_len;
+
+  const auto k = static_cast<std::size_t>(index / d.span);
+  const auto *entry = d.sparse_index + 6 * k;
+  auto block = read_little_endian<uint32_t>(entry);
+  long offset = read_little_endian<uint16_t>(entry + 4);
+
+  offset += static_cast<long>(index % d.span) - static_cast<long>(d.span / 2);
+
+  const auto block_length = [&](uint32_t b) {
+    return static_cast<long>(
+        read_little_endian<uint16_t>(d.block_length + 2 * std::size_t{b}));
+  };
+  while (offset < 0)
+    offset += block_length(--block) + 1;
+  while (offset > block_length(block))
+    offset -= block_length(block++) + 1;
+
+  const uint8_t *ptr = d.data + std::size_t{block} * d.block_size;
+  uint64_t buffer = read_big_endian<uint64_t>(ptr);
+  ptr += 8;
+  int buffer_size = 64;
+
+  std::size_t sym = 0;
+  while (true) {
+    std::size_t len = 0;
+    while (buffer < d.base64[len])
+      ++len;
+
+    sym = static_cast<std::size_t>(
+        (buffer - d.base64[len]) >>
+        (64 - len - static_cast<std::size_t>(d.min_sym_len)));
+    sym += read_little_endian<uint16_t>(d.lowest_sym + 2 * len);
+
+    if (offset < d.symlen[sym] + 1)
+      break;
+
+    offset -= d.symlen[sym] + 1;
+    len += static_cast<std::size_t>(d.min_sym_len);
+    buffer <<= len;
+    buffer_size -= static_cast<int>(len);
+
+    if (buffer_size <= 32) {
+      buffer_size += 32;
+      buffer |= static_cast<uint64_t>(read_big_endian<uint32_t>(ptr))
+                << (64 - buffer_size);
+      ptr += 4;
+    }
+  }
+
+  while (d.symlen[sym]) {
+    const auto left = static_cast<std::size_t>(left_symbol(d.btree, sym));
+    if (offset < d.symlen[left] + 1) {
+      sym = left;
+    } else {
+      offset -= d.symlen[left] + 1;
+      sym = static_cast<std::size_t>(right_symbol(d.btree, sym));
+    }
+  }
+
+  return left_symbol(d.btree, sym);
+}
+
+enum class TableType { WDL, DTZ };
+
+/* One table file. Created when the directories are scanned, the file is
+   mapped and the sub-tables are set up on first access. */
+struct Table {
+  TableType type;
+  std::filesystem::path path; // Empty if the file does not exist
+  uint64_t key = 0;           // Material with the first side as White
+  uint64_t key2 = 0;          // ... and with the first side as Black
+  int piece_count = 0;
+  bool has_pawns = false;
+  bool has_unique_pieces = false;
+  std::array<int, 2> pawn_count = {}; // Leading side, other side
+
+  std::atomic<bool> ready{false};
+  std::optional<MappedFile> file;
+  const uint8_t *dtz_map = nullptr;
+  std::array<std::array<PairsData, 4>, 2> items;
+
+  int sides() const { return type == TableType::WDL ? 2 : 1; }
+
+  PairsData &get(int stm, int file_index) {
+    return items[idx(stm % sides())][has_pawns ? idx(file_index) : 0];
+  }
+};
+
+// Sets the groups of pieces that are encoded together and their offsets in
+// the index
+inline void set_groups(Table &e, PairsData &d, const std::array<int, 2> &order,
+                       int f) {
+  int n = 0;
+  int first_len = e.has_pawns ? 0 : e.has_unique_pieces ? 3 : 2;
+  d.group_len[0] = 1;
+
+  for (int i = 1; i < e.piece_count; ++i) {
+    if (--first_len > 0 || d.pieces[idx(i)] == d.pieces[idx(i - 1)])
+      d.group_len[idx(n)]++;
+    else
+      d.group_len[idx(++n)] = 1;
+  }
+  d.group_len[idx(++n)] = 0;
+
+  const bool pawns_on_both_sides = e.has_pawns && e.pawn_count[1];
+  int next = pawns_on_both_sides ? 2 : 1;
+  int free_squares =
+      64 - d.group_len[0] - (pawns_on_both_sides ? d.group_len[1] : 0);
+  uint64_t index = 1;
+
+  for (int k = 0; next < n || k == order[0] || k == order[1]; ++k) {
+    if (k == order[0]) {
+      d.group_idx[0] = index;
+      index *= static_cast<uint64_t>(
+          e.has_pawns
+              ? encoding.lead_pawns_size[idx(d.group_len[0])][idx(f)]
+          : e.has_unique_pieces ? 31332
+                                : 462);
+    } else if (k == order[1]) {
+      d.group_idx[1] = index;
+      index *= static_cast<uint64_t>(
+          encoding.binomial[idx(d.group_len[1])][idx(48 - d.group_len[0])]);
+    } else {
+      d.group_idx[idx(next)] = index;
+      index *= static_cast<uint64_t>(
+          encoding.binomial[idx(d.group_len[idx(next)])][idx(free_squares)]);
+      free_squares -= d.group_len[idx(next++)];
+    }
+  }
+  d.group_idx[idx(n)] = index;
+}
+
+inline uint8_t set_symlen(PairsData &d, std::size_t sym,
+                          std::vector<bool> &visited) {
+  visited[sym] = true;
+  const auto right = static_cast<std::size_t>(right_symbol(d.btree, sym));
+  if (right == 0xFFF)
+    return 0;
+
+  const auto left = static_cast<std::size_t>(left_symbol(d.btree, sym));
+  if (not visited[left])
+    d.symlen[left] = set_symlen(d, left, visited);
+  if (not visited[right])
+    d.symlen[right] = set_symlen(d, right, visited);
+
+  return static_cast<uint8_t>(d.symlen[left] + d.symlen[right] + 1);
+}
+
+// Checks that `size` more bytes can be read at `data` (which is never past
+// `end`). Every read from a table file is checked first, as the files may be
+// truncated or corrupt.
+inline bool fits(const uint8_t *data, const uint8_t *end, std::size_t size) {
+  return static_cast<std::size_t>(end - data) >= size;
+}
+
+// Reads the sizes and the Huffman code of a sub-table. Returns nullptr if the
+// data ends early or is inconsistent.
+inline const uint8_t *set_sizes(PairsData &d, const uint8_t *data,
+                                const uint8_t *end) {
+  if (not fits(data, end, 1))
+    return nullptr;
+  d.flags = *data++;
+
+  if (d.flags & SingleValue) {
+    if (not fits(data, end, 1))
+      return nullptr;
+    d.min_sym_len = *data++;
+    return data;
+  }
+
+  const auto groups = static_cast<std::size_t>(
+      std::find(d.group_len.begin(), d.group_len.end(), 0) -
+      d.group_len.begin());
+  const uint64_t table_size = d.group_idx[groups];
+
+  if (not fits(data, end, 9) || data[0] > 31 || data[1] > 31)
+    return nullptr;
+  d.block_size = std::size_t{1} << *data++;
+  d.span = std::size_t{1} << *data++;
+  d.sparse_index_size =
+      static_cast<std::size_t>((table_size + d.span - 1) / d.span);
+  const auto padding = *data++;
+  d.num_blocks = read_little_endian<uint32_t>(data);
+  data += 4;
+  d.block_length_size = d.num_blocks + padding;
+  d.max_sym_len = *data++;
+  d.min_sym_len = *data++;
+  d.lowest_sym = data;
+
+  // The codes are between 1 and 63 bits long (see the shifts below)
+  if (d.min_sym_len < 1 || d.max_sym_len < d.min_sym_len ||
+      d.max_sym_len > 63)
+    return nullptr;
+  const auto lengths =
+      static_cast<std::size_t>(d.max_sym_len - d.min_sym_len + 1);
+  if (not fits(data, end, lengths * 2 + 2))
+    return nullptr;
+
+  // Canonical Huffman code: longer codes have lower values. base64[i] is the
+  // lowest code of length min_sym_len + i, left aligned to 64 bits.
+  d.base64.assign(lengths, 0);
+  for (std::size_t i = lengths - 1; i-- > 0;)
+    d.base64[i] = (d.base64[i + 1] +
+                   read_little_endian<uint16_t>(d.lowest_sym + 2 * i) -
+                   read_little_endian<uint16_t>(d.lowest_sym + 2 * (i + 1))) /
+                  2;
+  for (std::size_t i = 0; i < lengths; ++i)
+    d.base64[i] <<= 64 - i - static_cast<std::size_t>(d.min_sym_len);
+
+  data += lengths * 2;
+  d.symlen.assign(read_little_endian<uint16_t>(data), 0);
+  data += 2;
+  d.btree = data;
+
+  const auto btree_size = d.symlen.size() * 3 + (d.symlen.size() & 1);
+  if (not fits(data, end, btree_size))
+    return nullptr;
+
+  // Pairs have to refer to existing symbols
+  for (std::size_t sym = 0; sym < d.symlen.size(); ++sym) {
+    const auto right = static_cast<std::size_t>(right_symbol(d.btree, sym));
+    const auto left = static_cast<std::size_t>(left_symbol(d.btree, sym));
+    if (right != 0xFFF &&
+        (left >= d.symlen.size() || right >= d.symlen.size()))
+      return nullptr;
+  }
+
+  std::vector<bool> visited(d.symlen.size());
+  for (std::size_t sym = 0; sym < d.symlen.size(); ++sym)
+    if (not visited[sym])
+      d.symlen[sym] = set_symlen(d, sym, visited);
+
+  return data + btree_size;
+}
+
+// DTZ values are stored as indices into a per-table map, sorted by frequency.
+// Returns nullptr if the data ends early.
+inline const uint8_t *set_dtz_map(Table &e, const uint8_t *base,
+                                  const uint8_t *data, const uint8_t *end,
+                                  int max_file) {
+  e.dtz_map = data;
+
+  for (int f = 0; f <= max_file; ++f) {
+    auto &d = e.get(0, f);
+    if (not(d.flags & Mapped))
+      continue;
+
+    if (d.flags & Wide) {
+      const auto alignment = static_cast<std::size_t>((data - base) & 1);
+      if (not fits(data, end, alignment))
+        return nullptr;
+      data += alignment;
+      for (auto &map_idx : d.map_idx) {
+        if (not fits(data, end, 2))
+          return nullptr;
+        const auto size =
+            2 * std::size_t{read_little_endian<uint16_t>(data)} + 2;
+        if (not fits(data, end, size))
+          return nullptr;
+        map_idx = static_cast<std::size_t>(data - e.dtz_map) / 2 + 1;
+        data += size;
+      }
+    } else {
+      for (auto &map_idx : d.map_idx) {
+        if (not fits(data, end, 1) || not fits(data, end, *data + 1U))
+          return nullptr;
+        map_idx = static_cast<std::size_t>(data - e.dtz_map) + 1;
+        data += *data + 1;
+      }
+    }
+  }
+
+  const auto alignment = static_cast<std::size_t>((data - base) & 1);
+  return fits(data, end, alignment) ? data + alignment : nullptr;
+}
+
+// Sets up the sub-tables of a freshly mapped file. Returns false if the
+// header does not match the table or the file is too short.
+inline bool set_tables(Table &e, const uint8_t *base, const uint8_t *end) {
+  enum { Split = 1, HasPawns = 2 };
+
+  if (not fits(base, end, 5))
+    return false;
+  const uint8_t *data = base + 4; // Skip the magic bytes
+  if (bool(*data & HasPawns) != e.has_pawns)
+    return false;
+  if (e.type == TableType::WDL && bool(*data & Split) != (e.key != e.key2))
+    return false;
+  ++data;
+
+  const int sides = e.type == TableType::WDL && e.key != e.key2 ? 2 : 1;
+  const int max_file = e.has_pawns ? 3 : 0;
+  const bool pawns_on_both_sides = e.has_pawns && e.pawn_count[1];
+
+  for (int f = 0; f <= max_file; ++f) {
+    for (int i = 0; i < sides; ++i)
+      e.get(i, f) = PairsData{};
+
+    if (not fits(data, end,
+                 1U + pawns_on_both_sides +
+                     static_cast<std::size_t>(e.piece_count)))
+      return false;
+    const std::array<std::array<int, 2>, 2> order = {
+        {{*data & 0xF, pawns_on_both_sides ? *(data + 1) & 0xF : 0xF},
+         {*data >> 4, pawns_on_both_sides ? *(data + 1) >> 4 : 0xF}}};
+    data += 1 + pawns_on_both_sides;
+
+    for (int k = 0; k < e.piece_count; ++k, ++data)
+      for (int i = 0; i < sides; ++i)
+        e.get(i, f).pieces[idx(k)] = i ? *data >> 4 : *data & 0xF;
+
+    for (int i = 0; i < sides; ++i)
+      set_groups(e, e.get(i, f), order[idx(i)], f);
+  }
+
+  // Skips `size` bytes, returns false if that goes past the end
+  const auto skip = [&](std::size_t size) {
+    if (not fits(data, end, size))
+      return false;
+    data += size;
+    return true;
+  };
+
+  if (not skip(static_cast<std::size_t>((data - base) & 1)))
+    return false;
+
+  for (int f = 0; f <= max_file; ++f)
+    for (int i = 0; i < sides; ++i)
+      if (not(data = set_sizes(e.get(i, f), data, end)))
+        return false;
+
+  if (e.type == TableType::DTZ &&
+      not(data = set_dtz_map(e, base, data, end, max_file)))
+    return false;
+
+  for (int f = 0; f <= max_file; ++f)
+    for (int i = 0; i < sides; ++i) {
+      auto &d = e.get(i, f);
+      d.sparse_index = data;
+      if (not skip(d.sparse_index_size * 6))
+        return false;
+    }
+
+  for (int f = 0; f <= max_file; ++f)
+    for (int i = 0; i < sides; ++i) {
+      auto &d = e.get(i, f);
+      d.block_length = data;
+      if (not skip(d.block_length_size * 2))
+        return false;
+    }
+
+  for (int f = 0; f <= max_file; ++f)
+    for (int i = 0; i < sides; ++i) {
+      auto &d = e.get(i, f);
+      // 64 byte alignment
+      if (not skip(static_cast<std::size_t>(-(data - base) & 0x3F)))
+        return false;
+      d.data = data;
+      if (not skip(d.num_blocks * d.block_size))
+        return false;
+    }
+
+  return true;
+}
+
+// Piece type codes of the tables
+inline int piece_code(Piece piece) {
+  switch (piece) {
+  case Piece::Pawn:
+    return 1;
+  case Piece::Knight:
+    return 2;
+  case Piece::Bishop:
+    return 3;
+  case Piece::Rook:
+    return 4;
+  case Piece::Queen:
+    return 5;
+  case Piece::King:
+    return 6;
+  default:
+    __builtin_unreachable();
+  }
+}
+
+/* A key identifying the material of a position: the number of pawns,
+   knights, bishops, rooks and queens of each side in 4 bits each. */
+inline uint64_t material_key(const std::array<std::array<int, 7>, 2> &counts) {
+  uint64_t key = 0;
+  for (std::size_t colour = 0; colour < 2; ++colour)
+    for (std::size_t code = 1; code <= 5; ++code)
+      key |= static_cast<uint64_t>(counts[colour][code])
+             << (4 * (5 * colour + code - 1));
+  return key;
+}
+
+inline std::array<std::array<int, 7>, 2> count_material(const mcc &board) {
+  std::array<std::array<int, 7>, 2> counts = {};
+  for (auto colour : {Colour::White, Colour::Black})
+    for (auto piece : get_all_pieces())
+      counts[colour][idx(piece_code(piece))] =
+          std::popcount(board.get_bitboard(piece, colour));
+  return counts;
+}
+
+// Values of the DTZ of the move before a zeroing move for each WDLScore
+inline int dtz_before_zeroing(WDLScore wdl) {
+  return wdl == Win           ? 1
+         : wdl == CursedWin   ? 101
+         : wdl == BlessedLoss ? -101
+         : wdl == Loss        ? -1
+                              : 0;
+}
+
+template <typename T> int sign_of(T value) {
+  return (T(0) < value) - (value < T(0));
+}
+} // namespace detail
+
+/* The tablebases found in a set of directories. The directories are given as
+   a single string separated by ':' (like PATH). */
+class Tablebases {
+public:
+  explicit Tablebases(std::string_view paths) {
+    std::size_t start = 0;
+    while (start <= paths.size()) {
+      auto end = paths.find(':', start);
+      if (end == std::string_view::npos)
+        end = paths.size();
+      if (end > start)
+        directories.emplace_back(paths.substr(start, end - start));
+      start = end + 1;
+    }
+
+    for (const auto &directory : directories) {
+      std::error_code error;
+      for (const auto &entry :
+           std::filesystem::directory_iterator(directory, error)) {
+        if (entry.path().extension() == ".rtbw")
+          add(entry.path().stem().string());
+      }
+    }
+  }
+
+  Tablebases(const Tablebases &) = delete;
+  Tablebases &operator=(const Tablebases &) = delete;
+
+  // Number of WDL tables found
+  std::size_t size() const { return tables.size(); }
+
+  // Largest number of pieces (including kings) of the tables found
+  int get_max_pieces() const { return max_pieces; }
+
+  /* Probes the WDL tables. The result is from the point of view of the side
+     to move and only valid if `state` is not Fail afterwards. The position
+     must not have castling rights. */
+  WDLScore probe_wdl(mcc &board, ProbeState &state) const {
+    state = ProbeState::Ok;
+    return search(board, state, false);
+  }
+
+  /* Probes the DTZ tables. Returns the number of plies to the next zeroing
+     move (capture or pawn move) in an optimally played game, from the point
+     of view of the side to move:
+           n < -100 : loss, but draw under the 50-move rule
+     -100 <= n < -1 : loss in n plies
+               -1   : loss, the side to move is mated
+                0   : draw
+       1 < n <= 100 : win in n plies
+         100 < n    : win, but draw under the 50-move rule
+     A value of n can also mean n + 1 plies. */
+  int probe_dtz(mcc &board, ProbeState &state) const {
+    state = ProbeState::Ok;
+    const auto wdl = search(board, state, true);
+
+    if (state == ProbeState::Fail || wdl == Draw)
+      return 0;
+
+    // The tables do not store the DTZ if the best move is zeroing
+    if (state == ProbeState::ZeroingBestMove)
+      return detail::dtz_before_zeroing(wdl);
+
+    int dtz = probe_table(board, detail::TableType::DTZ, state, wdl);
+    if (state == ProbeState::Fail)
+      return 0;
+
+    if (state != ProbeState::ChangeSideToMove)
+      return (dtz + 100 * (wdl == BlessedLoss || wdl == CursedWin)) *
+             detail::sign_of(static_cast<int>(wdl));
+
+    // The table only stores the other side to move, search one ply and take
+    // the best DTZ of the moves
+    int min_dtz = 0xFFFF;
+    for (const auto &move : board.generate_moves()) {
+      const bool zeroing = move.is_capture() || move.get_piece() == Piece::Pawn;
+
+      // For zeroing moves the DTZ before the move is wanted, the WDL score
+      // after it tells whether the move wins, draws or loses
+      board.make_move(move);
+      dtz = zeroing ? -detail::dtz_before_zeroing(search(board, state, false))
+                    : -probe_dtz(board, state);
+
+      // Mate in one
+      if (dtz == 1 && board.in_check() && board.generate_moves().empty())
+        min_dtz = 1;
+
+      if (not zeroing)
+        dtz += detail::sign_of(dtz);
+
+      if (dtz < min_dtz && detail::sign_of(dtz) == detail::sign_of(static_cast<int>(wdl)))
+        min_dtz = dtz;
+
+      board.unmake_move();
+
+      if (state == ProbeState::Fail)
+        return 0;
+    }
+
+    // Without legal moves the side to move is mated
+    return min_dtz == 0xFFFF ? -1 : min_dtz;
+  }
+
+  /* Ranks the legal moves of the root position with the DTZ tables, or the
+     WDL tables if no DTZ table is available, and returns the moves with the
+     best rank. Among winning moves, those that reach the next zeroing move
+     fastest are preferred, so the engine always makes progress. Wins that
+     are draws under the 50-move rule rank below real wins but above draws.
+     Returns an empty vector if the position cannot be probed. */
+  std::vector<Move> filter_root_moves(mcc &board, bool use_rule50) const {
+    auto ranked = rank_root_moves_dtz(board);
+    if (ranked.empty())
+      ranked = rank_root_moves_wdl(board, use_rule50);
+
+    std::vector<Move> best_moves;
+    if (ranked.empty())
+      return best_moves;
+
+    const auto best_rank =
+        std::max_element(ranked.begin(), ranked.end(),
+                         [](const RankedMove &a, const RankedMove &b) {
+                           return a.rank < b.rank;
+                         })
+            ->rank;
+    for (const auto &[move, rank] : ranked)
+      if (rank == best_rank)
+        best_moves.push_back(move);
+    return best_moves;
+  }
+
+  // Ranks the root moves by their DTZ, counted from the root position.
+  // Returns an empty vector if a table is missing.
+  std::vector<RankedMove> rank_root_moves_dtz(mcc &board) const {
+    const int half_moves = static_cast<int>(board.get_half_moves());
+    // As in Stockfish, wins are only ranked by their DTZ if the game has not
+    // gone through a repetition since the last zeroing move
+    const bool repeated = board.has_repeated();
+
+    std::vector<RankedMove> ranked;
+    ProbeState state = ProbeState::Ok;
+    for (const auto &move : board.generate_moves()) {
+      board.make_move(move);
+
+      int dtz = 0;
+      if (board.get_half_moves() == 0) {
+        // Zeroing move: the DTZ is one of -101, -1, 0, 1, 101
+        const auto wdl = static_cast<WDLScore>(-probe_wdl(board, state));
+        dtz = detail::dtz_before_zeroing(wdl);
+      } else if (not board.is_game_drawn()) {
+        dtz = -probe_dtz(board, state);
+        dtz = dtz > 0 ? dtz + 1 : dtz < 0 ? dtz - 1 : dtz;
+      }
+
+      // A mating move has a DTZ of 1
+      if (dtz == 2 && board.in_check() && board.generate_moves().empty())
+        dtz = 1;
+
+      board.unmake_move();
+      if (state == ProbeState::Fail)
+        return {};
+
+      // Wins within the 50 moves are ranked by their DTZ, losses that the
+      // 50-move rule will turn into a draw are preferred over other losses
+      int rank = 0;
+      if (dtz > 0)
+        rank = dtz + half_moves <= 99 && not repeated
+                   ? max_dtz - dtz
+                   : max_dtz / 2 - (dtz + half_moves);
+      else if (dtz < 0)
+        rank = -dtz * 2 + half_moves < 100
+                   ? -max_dtz - dtz
+                   : -max_dtz / 2 + (-dtz + half_moves);
+      ranked.push_back({move, rank});
+    }
+    return ranked;
+  }
+
+  // Ranks the root moves by their WDL score only. Without `use_rule50`,
+  // cursed wins and blessed losses count as wins and losses.
+  std::vector<RankedMove> rank_root_moves_wdl(mcc &board,
+                                              bool use_rule50) const {
+    constexpr std::array<int, 5> wdl_to_rank = {
+        -max_dtz, -max_dtz + 101, 0, max_dtz - 101, max_dtz};
+
+    std::vector<RankedMove> ranked;
+    ProbeState state = ProbeState::Ok;
+    for (const auto &move : board.generate_moves()) {
+      board.make_move(move);
+      auto wdl = static_cast<WDLScore>(-probe_wdl(board, state));
+      board.unmake_move();
+      if (state == ProbeState::Fail)
+        return {};
+
+      if (not use_rule50)
+        wdl = wdl > Draw ? Win : wdl < Draw ? Loss : Draw;
+      ranked.push_back({move, wdl_to_rank[static_cast<std::size_t>(wdl + 2)]});
+    }
+    return ranked;
+  }
+private:
+  // Upper bound of the DTZ values, used for ranking root moves
+  static constexpr int max_dtz = 1 << 18;
+
+  struct TablePair {
+    detail::Table wdl;
+    detail::Table dtz;
+  };
+
+  // Registers the table with the given name (like "KRPvKR") if it is valid
+  void add(const std::string &name) {
+    const auto v = name.find('v');
+    if (v == std::string::npos || v == 0 || v + 1 >= name.size() ||
+        name[0] != 'K' || name[v + 1] != 'K')
+      return;
+
+    std::array<std::array<int, 7>, 2> counts = {};
+    int piece_count = 0;
+    for (std::size_t i = 0; i < name.size(); ++i) {
+      if (i == v)
+        continue;
+      constexpr std::string_view codes = " PNBRQK";
+      const auto code = codes.find(name[i]);
+      if (code == std::string_view::npos || code == 0)
+        return;
+      counts[i < v ? 0 : 1][code]++;
+      ++piece_count;
+    }
+    if (piece_count > detail::max_table_pieces ||
+        counts[0][6] != 1 || counts[1][6] != 1)
+      return;
+
+    std::array<std::array<int, 7>, 2> swapped = {counts[1], counts[0]};
+    const auto key = detail::material_key(counts);
+    if (index.contains(key))
+      return;
+
+    auto &pair = tables.emplace_back();
+    for (auto *table : {&pair.wdl, &pair.dtz}) {
+      table->key = key;
+      table->key2 = detail::material_key(swapped);
+      table->piece_count = piece_count;
+      table->has_pawns = counts[0][1] + counts[1][1] > 0;
+      for (std::size_t colour = 0; colour < 2; ++colour)
+        for (std::size_t code = 1; code <= 5; ++code)
+          if (counts[colour][code] == 1)
+            table->has_unique_pieces = true;
+
+      // The leading side is the one with fewer pawns (but at least one)
+      const bool white_leads =
+          not counts[1][1] || (counts[0][1] && counts[1][1] >= counts[0][1]);
+      table->pawn_count = {counts[white_leads ? 0 : 1][1],
+                           counts[white_leads ? 1 : 0][1]};
+    }
+
+    pair.wdl.type = detail::TableType::WDL;
+    pair.dtz.type = detail::TableType::DTZ;
+    pair.wdl.path = find_file(name + ".rtbw");
+    pair.dtz.path = find_file(name + ".rtbz");
+
+    index[pair.wdl.key] = tables.size() - 1;
+    index[pair.wdl.key2] = tables.size() - 1;
+    max_pieces = std::max(max_pieces, piece_count);
+  }
+
+  std::filesystem::path find_file(const std::string &file_name) const {
+    for (const auto &directory : directories) {
+      auto path = std::filesystem::path(directory) / file_name;
+      std::error_code error;
+      if (std::filesystem::exists(path, error))
+        return path;
+    }
+    return {};
+  }
+
+  // Maps the file on first access, returns false if it is not available
+  bool map(detail::Table &table) const {
+    if (table.ready.load(std::memory_order_acquire))
+      return table.file.has_value();
+
+    std::lock_guard lock{mutex};
+    if (table.ready.load(std::memory_order_relaxed))
+      return table.file.has_value();
+
+    if (not table.path.empty()) {
+      try {
+        table.file.emplace(table.path);
+        table.file->advise_random();
+
+        constexpr std::array<std::array<uint8_t, 4>, 2> magics = {
+            {{0x71, 0xE8, 0x23, 0x5D}, {0xD7, 0x66, 0x0C, 0xA5}}};
+        const auto &magic =
+            magics[table.type == detail::TableType::WDL ? 0 : 1];
+        const auto *base =
+            reinterpret_cast<const uint8_t *>(table.file->data());
+        const auto size = table.file->get_size();
+
+        if (size < 5 || not std::equal(magic.begin(), magic.end(), base) ||
+            not detail::set_tables(table, base, base + size))
+          table.file.reset();
+      } catch (const std::runtime_error &) {
+        table.file.reset();
+      }
+    }
+
+    table.ready.store(true, std::memory_order_release);
+    return table.file.has_value();
+  }
+
+  /* Looks up the position in the table of the given type. For WDL tables the
+     result is a WDLScore, for DTZ tables the distance in plies for the given
+     WDL score. */
+  int probe_table(mcc &board, detail::TableType type, ProbeState &state,
+                  WDLScore wdl = Draw) const {
+    using namespace detail;
+
+    if (std::popcount(board.get_occupied()) == 2)
+      return Draw; // KvK
+
+    const auto key = material_key(count_material(board));
+    const auto it = index.find(key);
+    if (it == index.end()) {
+      state = ProbeState::Fail;
+      return 0;
+    }
+    auto &pair = tables[it->second];
+    auto &e = type == TableType::WDL ? pair.wdl : pair.dtz;
+    if (not map(e)) {
+      state = ProbeState::Fail;
+      return 0;
+    }
+
+    const int side_to_move = board.get_active_colour();
+
+    /* The tables store positions with the first side of the name as White.
+       If Black has that material, swap the colours and flip the board.
+       Tables of symmetric material only store White to move. */
+    const bool symmetric_black_to_move = e.key == e.key2 && side_to_move;
+    const bool black_stronger = key != e.key;
+    const bool flip = symmetric_black_to_move || black_stronger;
+    const int flip_colour = flip ? 8 : 0;
+    const int flip_squares = flip ? 56 : 0;
+    const int stm = flip ^ side_to_move;
+
+    std::array<int, max_table_pieces> squares = {};
+    std::array<int, max_table_pieces> pieces = {};
+    std::size_t size = 0;
+    std::size_t lead_pawns_count = 0;
+    uint64_t lead_pawns = 0;
+    int tb_file = 0;
+
+    // Table square of a board square
+    const auto to_square = [](int square) { return square ^ 56; };
+    const auto pawns_less = [](int a, int b) {
+      return encoding.map_pawns[idx(a)] < encoding.map_pawns[idx(b)];
+    };
+
+    if (e.has_pawns) {
+      // The leading pawns come first, their colour is stored in the table
+      const int piece = e.get(0, 0).pieces[0] ^ flip_colour;
+      const auto colour = piece & 8 ? Colour::Black : Colour::White;
+
+      lead_pawns = board.get_bitboard(Piece::Pawn, colour);
+      for (auto b = lead_pawns; b; b &= b - 1)
+        squares[size++] = to_square(std::countr_zero(b)) ^ flip_squares;
+      lead_pawns_count = size;
+
+      std::swap(squares[0],
+                *std::max_element(squares.begin(),
+                                  squares.begin() +
+                                      static_cast<long>(lead_pawns_count),
+                                  pawns_less));
+      tb_file = std::min(file_of(squares[0]), 7 - file_of(squares[0]));
+    }
+
+    // DTZ tables may only store one side to move
+    if (type == TableType::DTZ) {
+      const int flags = e.get(stm, tb_file).flags;
+      if ((flags & SideToMove) != stm && not(e.key == e.key2 && not e.has_pawns)) {
+        state = ProbeState::ChangeSideToMove;
+        return 0;
+      }
+    }
+
+    const auto white = board.occupied_by(Colour::White);
+    for (auto b = board.get_occupied() & ~lead_pawns; b; b &= b - 1) {
+      const int square = std::countr_zero(b);
+      const int colour_bit = (white >> square) & 1 ? 0 : 8;
+      squares[size] = to_square(square) ^ flip_squares;
+      pieces[size++] =
+          (piece_code(*board.get_piece_on(square)) | colour_bit) ^ flip_colour;
+    }
+
+    auto &d = e.get(stm, tb_file);
+
+    // Reorder the pieces to the order used by the table
+    for (std::size_t i = lead_pawns_count; i + 1 < size; ++i)
+      for (std::size_t j = i + 1; j < size; ++j)
+        if (d.pieces[i] == pieces[j]) {
+          std::swap(pieces[i], pieces[j]);
+          std::swap(squares[i], squares[j]);
+          break;
+        }
+
+    // Mirror so that the leading piece is on files a-d
+    if (file_of(squares[0]) > 3)
+      for (std::size_t i = 0; i < size; ++i)
+        squares[i] = flip_file(squares[i]);
+
+    uint64_t index_in_table = 0;
+    if (e.has_pawns) {
+      index_in_table = static_cast<uint64_t>(
+          encoding.lead_pawn_idx[lead_pawns_count][idx(squares[0])]);
+      std::stable_sort(squares.begin() + 1,
+                       squares.begin() + static_cast<long>(lead_pawns_count),
+                       pawns_less);
+      for (std::size_t i = 1; i < lead_pawns_count; ++i)
+        index_in_table += static_cast<uint64_t>(
+            encoding.binomial[i][idx(encoding.map_pawns[idx(squares[i])])]);
+    } else {
+      // Without pawns, also mirror the leading piece to ranks 1-4 and below
+      // the a1-h8 diagonal
+      if (rank_of(squares[0]) > 3)
+        for (std::size_t i = 0; i < size; ++i)
+          squares[i] = flip_rank(squares[i]);
+
+      for (std::size_t i = 0; i < idx(d.group_len[0]); ++i) {
+        if (not off_a1h8(squares[i]))
+          continue;
+        if (off_a1h8(squares[i]) > 0)
+          for (std::size_t j = i; j < size; ++j)
+            squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+        break;
+      }
+
+      if (e.has_unique_pieces) {
+        // The first three pieces are encoded together
+        const int adjust1 = squares[1] > squares[0];
+        const int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+
+        int i = 0;
+        if (off_a1h8(squares[0]))
+          i = (encoding.map_a1d1d4[idx(squares[0])] * 63 +
+               (squares[1] - adjust1)) * 62 +
+              squares[2] - adjust2;
+        else if (off_a1h8(squares[1]))
+          i = (6 * 63 + rank_of(squares[0]) * 28 +
+               encoding.map_b1h1h7[idx(squares[1])]) * 62 +
+              squares[2] - adjust2;
+        else if (off_a1h8(squares[2]))
+          i = 6 * 63 * 62 + 4 * 28 * 62 + rank_of(squares[0]) * 7 * 28 +
+              (rank_of(squares[1]) - adjust1) * 28 +
+              encoding.map_b1h1h7[idx(squares[2])];
+        else
+          i = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 +
+              rank_of(squares[0]) * 7 * 6 +
+              (rank_of(squares[1]) - adjust1) * 6 +
+              (rank_of(squares[2]) - adjust2);
+        index_in_table = static_cast<uint64_t>(i);
+      } else {
+        // Only the two kings are encoded together
+        index_in_table = static_cast<uint64_t>(
+            encoding.map_kk[idx(encoding.map_a1d1d4[idx(squares[0])])]
+                           [idx(squares[1])]);
+      }
+    }
+
+    // Encode the remaining groups, each sorted by square
+    index_in_table *= d.group_idx[0];
+    auto group_begin = idx(d.group_len[0]);
+    bool remaining_pawns = e.has_pawns && e.pawn_count[1];
+
+    for (std::size_t next = 1; d.group_len[next]; ++next) {
+      const auto group_len = idx(d.group_len[next]);
+      const auto group = squares.begin() + static_cast<long>(group_begin);
+      std::stable_sort(group, group + static_cast<long>(group_len));
+
+      uint64_t n = 0;
+      for (std::size_t i = 0; i < group_len; ++i) {
+        const auto adjust = std::count_if(
+            squares.begin(), group,
+            [&](int square) { return group[static_cast<long>(i)] > square; });
+        n += static_cast<uint64_t>(
+            encoding.binomial[i + 1][idx(group[static_cast<long>(i)] -
+                                         static_cast<int>(adjust) -
+                                         8 * remaining_pawns)]);
+      }
+
+      remaining_pawns = false;
+      index_in_table += n * d.group_idx[next];
+      group_begin += group_len;
+    }
+
+    const int value = decompress_pairs(d, index_in_table);
+    if (type == TableType::WDL)
+      return value - 2;
+    return map_dtz(e, tb_file, value, wdl);
+  }
+
+  // Converts a stored DTZ value to plies
+  static int map_dtz(detail::Table &e, int file_index, int value,
+                     WDLScore wdl) {
+    constexpr std::array<std::size_t, 5> wdl_map = {1, 3, 0, 2, 0};
+
+    const auto &d = e.get(0, file_index);
+    if (d.flags & detail::Mapped) {
+      const auto map_index =
+          d.map_idx[wdl_map[static_cast<std::size_t>(wdl + 2)]] +
+          static_cast<std::size_t>(value);
+      value = d.flags & detail::Wide
+                  ? detail::read_little_endian<uint16_t>(e.dtz_map +
+                                                         2 * map_index)
+                  : e.dtz_map[map_index];
+    }
+
+    // The tables store moves or plies, depending on the flags
+    if ((wdl == Win && not(d.flags & detail::WinPlies)) ||
+        (wdl == Loss && not(d.flags & detail::LossPlies)) ||
+        wdl == CursedWin || wdl == BlessedLoss)
+      value *= 2;
+
+    return value + 1;
+  }
+
+  /* The tables store "don't care" values for positions where a capture (or,
+     for DTZ, a pawn move) is the best move, so captures have to be searched
+     and the best result of them and of the table is the value of the
+     position. */
+  WDLScore search(mcc &board, ProbeState &state,
+                  bool check_zeroing_moves) const {
+    auto best_value = Loss;
+    auto value = Loss;
+
+    const auto moves = board.generate_moves();
+    std::size_t move_count = 0;
+    for (const auto &move : moves) {
+      if (not move.is_capture() &&
+          (not check_zeroing_moves || move.get_piece() != Piece::Pawn))
+        continue;
+
+      ++move_count;
+      board.make_move(move);
+      value = static_cast<WDLScore>(-search(board, state, false));
+      board.unmake_move();
+
+      if (state == ProbeState::Fail)
+        return Draw;
+
+      if (value > best_value) {
+        best_value = value;
+        if (value >= Win) {
+          state = ProbeState::ZeroingBestMove;
+          return value;
+        }
+      }
+    }
+
+    // If all moves have been searched, the table may be wrong (for example
+    // it does not know about en passant)
+    const bool no_more_moves = move_count && move_count == moves.size();
+    if (no_more_moves) {
+      value = best_value;
+    } else {
+      value = static_cast<WDLScore>(
+          probe_table(board, detail::TableType::WDL, state));
+      if (state == ProbeState::Fail)
+        return Draw;
+    }
+
+    if (best_value >= value) {
+      state = best_value > Draw || no_more_moves ? ProbeState::ZeroingBestMove
+                                                 : ProbeState::Ok;
+      return best_value;
+    }
+
+    state = ProbeState::Ok;
+    return value;
+  }
+
+  std::vector<std::string> directories;
+  mutable std::deque<TablePair> tables;
+  std::unordered_map<uint64_t, std::size_t> index;
+  int max_pieces = 0;
+  mutable std::mutex mutex;
+};
+} // namespace mcc::syzygy
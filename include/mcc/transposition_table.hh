@@ -0,0 +1,101 @@
+#pragma once
+
+#include "mcc/compact_move.hh"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mcc {
+enum class Bound : std::uint8_t { None = 0, Upper = 1, Lower = 2, Exact = 3 };
+
+/* A single entry of the transposition table, packed into 8 bytes. Only the
+   upper 16 bits of the key are stored, the lower bits are implied by the
+   position of the entry in the table. The last byte holds the bound (lowest
+   two bits) and the generation of the table the entry was stored in. */
+struct TTEntry {
+  std::uint16_t key;
+  CompactMove move;
+  std::int16_t score;
+  std::int8_t depth;
+  std::uint8_t bound_and_generation;
+
+  Bound bound() const { return static_cast<Bound>(bound_and_generation & 3); }
+  unsigned int generation() const { return bound_and_generation >> 2U; }
+};
+
+static_assert(sizeof(TTEntry) == 8);
+
+/* Hash table of search results, indexed by the Zobrist key of the position.
+   On collisions, the existing entry is replaced unless it belongs to the same
+   position and was searched considerably deeper.
+
+   Clearing the table only starts a new generation, entries of older
+   generations are treated as empty. The entries are actually overwritten
+   only when the generation counter wraps around, so clearing the table
+   before every search is cheap even for large tables. */
+class TranspositionTable {
+public:
+  explicit TranspositionTable(std::size_t megabytes = 16) { resize(megabytes); }
+
+  // Resizes the table to the largest power of two entries fitting into the
+  // given size and clears it
+  void resize(std::size_t megabytes) {
+    const auto bytes = std::max<std::size_t>(megabytes, 1) << 20;
+    entries.assign(std::bit_floor(bytes / sizeof(TTEntry)), TTEntry{});
+    mask = entries.size() - 1;
+    generation = 0;
+  }
+
+  void clear() {
+    generation = (generation + 1) % num_generations;
+    if (generation == 0)
+      std::fill(entries.begin(), entries.end(), TTEntry{});
+  }
+
+  // Returns the entry for the position with the given key, if there is one
+  const TTEntry *probe(std::uint64_t key) const {
+    const auto &entry = entries[key & mask];
+    if (entry.bound() == Bound::None || entry.generation() != generation ||
+        entry.key != verification_key(key))
+      return nullptr;
+    return &entry;
+  }
+
+  void store(std::uint64_t key, CompactMove move, int score, int depth,
+             Bound bound) {
+    auto &entry = entries[key & mask];
+    const bool same_position = entry.generation() == generation &&
+                               entry.key == verification_key(key);
+
+    if (same_position && bound != Bound::Exact && entry.depth > depth + 2)
+      return;
+
+    // Keep the old move if we did not find a new one
+    if (not move && same_position)
+      move = entry.move;
+
+    entry = TTEntry{verification_key(key), move,
+                    static_cast<std::int16_t>(score),
+                    static_cast<std::int8_t>(depth),
+                    static_cast<std::uint8_t>(static_cast<unsigned int>(bound) |
+                                              generation << 2U)};
+  }
+
+  std::size_t size() const { return entries.size(); }
+
+private:
+  static std::uint16_t verification_key(std::uint64_t key) {
+    return static_cast<std::uint16_t>(key >> 48);
+  }
+
+  // The generation is stored in the upper six bits of bound_and_generation
+  static constexpr unsigned int num_generations = 64;
+
+  std::vector<TTEntry> entries;
+  std::size_t mask = 0;
+  unsigned int generation = 0;
+};
+} // namespace mcc
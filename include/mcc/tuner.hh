@@ -0,0 +1,429 @@
+#pragma once
+
+#include "mcc/batch_loader.hh"
+#include "mcc/common/colour.hh"
+#include "mcc/common/piece.hh"
+#include "mcc/eval.hh"
+#include "mcc/mapped_file.hh"
+#include "mcc/mcc.hh"
+#include "mcc/packed_position.hh"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iomanip>
+#include <limits>
+#include <numbers>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace mcc::tuner {
+/*
+  Texel tuning of the evaluation parameters: the parameters are chosen to
+  minimise the mean squared error between the game results and the
+  evaluation mapped to an expected score,
+    E = 1/N sum_i (result_i - sigmoid(k * eval_i))^2
+    sigmoid(x) = 1 / (1 + 10^(-x / 400))
+  with results 1 (White won), 0.5 (draw) and 0 (Black won) and evaluations
+  from White's point of view.
+
+  The evaluation is linear in the parameters. A White piece on a square adds
+  its material value and piece-square value, a Black piece subtracts them
+  (with the square mirrored). So a position is stored as the list of its
+  piece-square indices, each with the colour in the top bit. All positions
+  are stored back to back in one array, which the loss and gradient loops
+  stream through. The material values do not need features of their own:
+  during an epoch they are folded into the piece-square values, and their
+  gradient is the sum of the gradients of their piece-square values.
+ */
+constexpr std::size_t num_pst_params = 6 * 64;
+// Piece-square values (piece_index(piece) * 64 + square) followed by the
+// material values (indexed by piece_index(piece))
+constexpr std::size_t num_params = num_pst_params + 6;
+
+inline std::vector<double> to_vector(const EvalParams &params) {
+  std::vector<double> vector(num_params);
+  for (std::size_t i = 0; i < num_pst_params; ++i)
+    vector[i] = params.pst[i / 64][i % 64];
+  for (std::size_t piece = 0; piece < 6; ++piece)
+    vector[num_pst_params + piece] = params.material[piece];
+  return vector;
+}
+
+inline EvalParams from_vector(const std::vector<double> &vector) {
+  const auto to_int = [](double value) {
+    return static_cast<int>(std::lround(value));
+  };
+  EvalParams params = {};
+  for (std::size_t i = 0; i < num_pst_params; ++i)
+    params.pst[i / 64][i % 64] = to_int(vector[i]);
+  for (std::size_t piece = 0; piece < 6; ++piece)
+    params.material[piece] = to_int(vector[num_pst_params + piece]);
+  return params;
+}
+
+// Positions with their game results, see the description above
+struct Dataset {
+  static constexpr std::uint16_t black = 1 << 15;
+  static constexpr std::uint16_t index_mask = black - 1;
+
+  std::vector<std::uint16_t> features;
+  // The features of position i are features[offsets[i]..offsets[i + 1]]
+  std::vector<std::uint32_t> offsets = {0};
+  std::vector<float> results;
+  std::size_t skipped = 0; // Unreadable positions or positions without result
+
+  std::size_t size() const { return results.size(); }
+
+  void add(const mcc &board, float result) {
+    // King and pawn versus king is not scored by the parameters
+    if (::mcc::detail::evaluate_kpk(board, default_eval_params)) {
+      ++skipped;
+      return;
+    }
+
+    for (auto colour : {Colour::White, Colour::Black}) {
+      const int flip = colour == Colour::White ? 0 : 56;
+      const std::size_t colour_bit = colour == Colour::White ? 0 : black;
+      for (auto piece : get_all_pieces()) {
+        for (auto b = board.get_bitboard(piece, colour); b; b &= b - 1) {
+          const auto square = std::countr_zero(b) ^ flip;
+          features.push_back(static_cast<std::uint16_t>(
+              colour_bit | (piece_index(piece) * 64 +
+                            static_cast<std::size_t>(square))));
+        }
+      }
+    }
+    push_offset();
+    results.push_back(result);
+  }
+
+  void append(const Dataset &other) {
+    const auto base = features.size();
+    features.insert(features.end(), other.features.begin(),
+                    other.features.end());
+    for (std::size_t i = 1; i < other.offsets.size(); ++i)
+      push_offset(base + other.offsets[i]);
+    results.insert(results.end(), other.results.begin(), other.results.end());
+    skipped += other.skipped;
+  }
+
+private:
+  void push_offset(std::size_t offset) {
+    if (offset > std::numeric_limits<std::uint32_t>::max())
+      throw std::length_error("[mcc::tuner::Dataset] Too many positions.");
+    offsets.push_back(static_cast<std::uint32_t>(offset));
+  }
+
+  void push_offset() { push_offset(features.size()); }
+};
+
+namespace detail {
+inline std::optional<float> result_from_string(std::string_view value) {
+  if (value == "1-0" || value == "1" || value == "1.0")
+    return 1.0f;
+  if (value == "0-1" || value == "0" || value == "0.0")
+    return 0.0f;
+  if (value == "1/2-1/2" || value == "0.5")
+    return 0.5f;
+  return {};
+}
+
+// Removes a bracketed result at the end of the line (see parse_result()),
+// which is not part of the FEN
+inline std::string_view strip_result(std::string_view line) {
+  const auto last = line.find_last_not_of(" \t\r");
+  if (last == std::string_view::npos || line[last] != ']')
+    return line;
+  return line.substr(0, line.rfind('[', last));
+}
+} // namespace detail
+
+/* Extracts the game result from a line of a text data set. Only two places
+   are looked at: a bracketed result at the end of the line (eg. "<fen>
+   [0.5]", also "[1.0]", "[0]", "[1-0]", ...) and the quoted operand of an EPD
+   "c9" or "result" opcode (eg. "<epd> c9 \"1/2-1/2\";"). Everything else,
+   like the operands of other opcodes, is ignored. */
+inline std::optional<float> parse_result(std::string_view line) {
+  const auto last = line.find_last_not_of(" \t\r");
+  if (last != std::string_view::npos && line[last] == ']') {
+    const auto open = line.rfind('[', last);
+    if (open == std::string_view::npos)
+      return {};
+    return detail::result_from_string(line.substr(open + 1, last - open - 1));
+  }
+
+  for (const std::string_view opcode : {"c9", "result"}) {
+    for (auto pos = line.find(opcode); pos != std::string_view::npos;
+         pos = line.find(opcode, pos + 1)) {
+      // The opcode has to be a word of its own, followed by a quoted operand
+      const auto operand = pos + opcode.size() + 2;
+      if ((pos > 0 && line[pos - 1] != ' ' && line[pos - 1] != ';') ||
+          operand > line.size() || line[operand - 2] != ' ' ||
+          line[operand - 1] != '"')
+        continue;
+      const auto close = line.find('"', operand);
+      if (close == std::string_view::npos)
+        return {};
+      return detail::result_from_string(
+          line.substr(operand, close - operand));
+    }
+  }
+  return {};
+}
+
+/* Loads a data set, either a text file with one FEN (or EPD) and result per
+   line, or a file of packed positions with results (as written by the
+   selfplay app, recognised by the extension .bin). The file is split into
+   `num_threads` parts which are converted in parallel. */
+inline Dataset
+load_dataset(const std::filesystem::path &path,
+             unsigned int num_threads = std::thread::hardware_concurrency()) {
+  num_threads = std::max(num_threads, 1U);
+  std::vector<Dataset> parts(num_threads);
+
+  if (path.extension() == ".bin") {
+    const PackedPositionReader reader(path);
+    const auto part_size = reader.size() / num_threads + 1;
+    std::vector<std::jthread> threads;
+    for (std::size_t t = 0; t < num_threads; ++t) {
+      threads.emplace_back([&, t]() {
+        mcc board;
+        const auto end = std::min(reader.size(), (t + 1) * part_size);
+        for (auto i = t * part_size; i < end; ++i) {
+          const auto &position = reader[i];
+          const auto result = position.result;
+          if ((result != GameResult::WhiteWin && result != GameResult::Draw &&
+               result != GameResult::BlackWin) ||
+              not position.unpack(board)) {
+            ++parts[t].skipped;
+            continue;
+          }
+          parts[t].add(board,
+                       (static_cast<float>(position.result) + 1.0f) / 2.0f);
+        }
+      });
+    }
+  } else {
+    const MappedFile file(path);
+    file.advise_sequential();
+    const auto chunks = split_into_line_chunks(file.view(), num_threads);
+    std::vector<std::jthread> threads;
+    for (std::size_t t = 0; t < chunks.size(); ++t) {
+      threads.emplace_back([&, t]() {
+        mcc board;
+        for_each_line(chunks[t], [&](std::string_view line, std::size_t) {
+          const auto result = parse_result(line);
+          if (result && board.load_from_fen(detail::strip_result(line)))
+            parts[t].add(board, *result);
+          else
+            ++parts[t].skipped;
+        });
+      });
+    }
+  }
+
+  Dataset dataset;
+  for (const auto &part : parts)
+    dataset.append(part);
+  return dataset;
+}
+
+/* Splits the positions into one range per thread and calls
+   f(begin, end, thread) for each range in parallel. */
+template <typename F>
+void parallel_for(std::size_t size, unsigned int num_threads, F &&f) {
+  num_threads = std::max(num_threads, 1U);
+  const auto part_size = size / num_threads + 1;
+  std::vector<std::jthread> threads;
+  for (std::size_t t = 0; t < num_threads; ++t)
+    threads.emplace_back([&, t]() {
+      f(std::min(size, t * part_size), std::min(size, (t + 1) * part_size), t);
+    });
+}
+
+namespace detail {
+// Combined value of each piece-square feature: material plus piece-square
+// value
+inline std::array<double, num_pst_params>
+feature_weights(const std::vector<double> &params) {
+  std::array<double, num_pst_params> weights = {};
+  for (std::size_t i = 0; i < num_pst_params; ++i)
+    weights[i] = params[i] + params[num_pst_params + i / 64];
+  return weights;
+}
+
+// Evaluation of position i from White's point of view
+inline double evaluate(const Dataset &data, std::size_t i,
+                       const std::array<double, num_pst_params> &weights) {
+  double eval = 0;
+  for (auto f = data.offsets[i]; f < data.offsets[i + 1]; ++f) {
+    const auto feature = data.features[f];
+    const double value = weights[feature & Dataset::index_mask];
+    eval += feature & Dataset::black ? -value : value;
+  }
+  return eval;
+}
+
+/* Adds the squared errors of the positions [begin, end) to `loss` and, if
+   `gradient` is not null, the derivatives of the squared errors with respect
+   to the feature weights to `gradient`. The positions are processed in
+   blocks: first the evaluations of the block are gathered, then the errors
+   are computed in a simple loop over contiguous arrays that the compiler can
+   vectorise, and finally the derivatives are scattered to the features. */
+inline void accumulate(const Dataset &data,
+                       const std::array<double, num_pst_params> &weights,
+                       double k, std::size_t begin, std::size_t end,
+                       double &loss, double *gradient) {
+  constexpr std::size_t block_size = 256;
+  const double scale = k * std::numbers::ln10 / 400.0;
+
+  std::array<double, block_size> evals;
+  std::array<double, block_size> derivatives;
+
+  for (auto block = begin; block < end; block += block_size) {
+    const auto count = std::min(block_size, end - block);
+
+    for (std::size_t j = 0; j < count; ++j)
+      evals[j] = evaluate(data, block + j, weights);
+
+    for (std::size_t j = 0; j < count; ++j) {
+      const double expected = 1.0 / (1.0 + std::exp(-scale * evals[j]));
+      const double error = expected - data.results[block + j];
+      loss += error * error;
+      derivatives[j] = 2.0 * error * expected * (1.0 - expected) * scale;
+    }
+
+    if (not gradient)
+      continue;
+    for (std::size_t j = 0; j < count; ++j) {
+      for (auto f = data.offsets[block + j]; f < data.offsets[block + j + 1];
+           ++f) {
+        const auto feature = data.features[f];
+        gradient[feature & Dataset::index_mask] +=
+            feature & Dataset::black ? -derivatives[j] : derivatives[j];
+      }
+    }
+  }
+}
+} // namespace detail
+
+/* Computes the mean squared error over all positions with `num_threads`
+   threads. If `gradient` is not null, it is set to the gradient of the error
+   with respect to the parameters. */
+inline double compute_loss(const Dataset &data,
+                           const std::vector<double> &params, double k,
+                           unsigned int num_threads,
+                           std::vector<double> *gradient = nullptr) {
+  const auto weights = detail::feature_weights(params);
+
+  num_threads = std::max(num_threads, 1U);
+  std::vector<double> losses(num_threads, 0.0);
+  std::vector<std::array<double, num_pst_params>> gradients(
+      gradient ? num_threads : 0);
+
+  parallel_for(data.size(), num_threads,
+               [&](std::size_t begin, std::size_t end, std::size_t thread) {
+                 detail::accumulate(
+                     data, weights, k, begin, end, losses[thread],
+                     gradient ? gradients[thread].data() : nullptr);
+               });
+
+  const auto n = static_cast<double>(std::max<std::size_t>(data.size(), 1));
+  double loss = 0;
+  for (auto thread_loss : losses)
+    loss += thread_loss;
+
+  if (gradient) {
+    gradient->assign(num_params, 0.0);
+    for (const auto &thread_gradient : gradients)
+      for (std::size_t i = 0; i < num_pst_params; ++i)
+        (*gradient)[i] += thread_gradient[i] / n;
+    for (std::size_t i = 0; i < num_pst_params; ++i)
+      (*gradient)[num_pst_params + i / 64] += (*gradient)[i];
+  }
+
+  return loss / n;
+}
+
+/* Finds the scaling constant k that minimises the error of the given
+   parameters (by ternary search, the error is unimodal in k). */
+inline double fit_k(const Dataset &data, const std::vector<double> &params,
+                    unsigned int num_threads) {
+  double low = 0.1;
+  double high = 3.0;
+  while (high - low > 1e-3) {
+    const double mid1 = low + (high - low) / 3;
+    const double mid2 = high - (high - low) / 3;
+    if (compute_loss(data, params, mid1, num_threads) <
+        compute_loss(data, params, mid2, num_threads))
+      high = mid2;
+    else
+      low = mid1;
+  }
+  return (low + high) / 2;
+}
+
+/* Gradient descent with the Adam update rule, which adapts the step size of
+   every parameter to the magnitude of its gradients. Parameters are in
+   centipawns, `learning_rate` is roughly the step per epoch in centipawns. */
+class AdamOptimizer {
+public:
+  explicit AdamOptimizer(double rate)
+      : learning_rate{rate}, moments(num_params, 0.0),
+        squared_moments(num_params, 0.0) {}
+
+  void step(std::vector<double> &params, const std::vector<double> &gradient) {
+    constexpr double beta1 = 0.9;
+    constexpr double beta2 = 0.999;
+    constexpr double epsilon = 1e-8;
+
+    ++steps;
+    const double correction1 = 1 - std::pow(beta1, steps);
+    const double correction2 = 1 - std::pow(beta2, steps);
+    for (std::size_t i = 0; i < params.size(); ++i) {
+      moments[i] = beta1 * moments[i] + (1 - beta1) * gradient[i];
+      squared_moments[i] =
+          beta2 * squared_moments[i] + (1 - beta2) * gradient[i] * gradient[i];
+      params[i] -= learning_rate * (moments[i] / correction1) /
+                   (std::sqrt(squared_moments[i] / correction2) + epsilon);
+    }
+  }
+
+private:
+  double learning_rate;
+  std::vector<double> moments;
+  std::vector<double> squared_moments;
+  int steps = 0;
+};
+
+// Writes the parameters as C++ code in the format of default_eval_params
+inline void write_params(std::ostream &out, const EvalParams &params) {
+  constexpr std::array<std::string_view, 6> names = {
+      "Pawn", "Rook", "Knight", "Bishop", "Queen", "King"};
+
+  out << "// clang-format off\n"
+      << "constexpr inline EvalParams default_eval_params = {\n    {";
+  for (std::size_t piece = 0; piece < 6; ++piece)
+    out << (piece > 0 ? ", " : "") << params.material[piece];
+  out << "},\n    {{\n";
+  for (std::size_t piece = 0; piece < 6; ++piece) {
+    out << "        // " << names[piece] << "\n";
+    for (std::size_t square = 0; square < 64; ++square) {
+      out << (square == 0 ? "        {" : square % 8 == 0 ? "         " : " ")
+          << std::setw(3) << params.pst[piece][square]
+          << (square == 63 ? "},\n" : square % 8 == 7 ? ",\n" : ",");
+    }
+  }
+  out << "    }}};\n"
+      << "// clang-format on\n";
+}
+} // namespace mcc::tuner
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "mcc/common/colour.hh"
+#include "mcc/common/helpers.hh"
+#include "mcc/common/piece.hh"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace mcc::zobrist {
+/*
+  Random keys used to compute the hash of a position. The key of a position is
+  the XOR of
+    - pieces[colour][piece_index(piece)][square] for every piece on the board,
+    - castling[rights] where `rights` is a 4 bit mask of the castling rights
+      (see castling_index()),
+    - en_passant[file] if there is an en passant square,
+    - side if Black is to move.
+ */
+struct Keys {
+  std::uint64_t pieces[2][6][64];
+  std::uint64_t castling[16];
+  std::uint64_t en_passant[8];
+  std::uint64_t side;
+};
+
+constexpr inline Keys keys = []() {
+  // xorshift64* with a fixed seed, so keys are identical on every run
+  std::uint64_t state = 1070372;
+  auto next = [&state]() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 2685821657736338717UL;
+  };
+
+  Keys k = {};
+  for (auto &colour : k.pieces)
+    for (auto &piece : colour)
+      for (auto &square : piece)
+        square = next();
+  for (auto &rights : k.castling)
+    rights = next();
+  for (auto &file : k.en_passant)
+    file = next();
+  k.side = next();
+  return k;
+}();
+
+constexpr std::size_t castling_index(bool white_kingside, bool white_queenside,
+                                     bool black_kingside,
+                                     bool black_queenside) {
+  return (white_kingside ? 1U : 0U) | (white_queenside ? 2U : 0U) |
+         (black_kingside ? 4U : 0U) | (black_queenside ? 8U : 0U);
+}
+
+constexpr std::uint64_t piece_key(Colour colour, Piece piece, int square) {
+  return keys.pieces[colour][piece_index(piece)]
+                    [static_cast<std::size_t>(square)];
+}
+
+/*
+  Cuckoo tables used to detect upcoming repetitions, ie. positions where the
+  side to move can reach a position that already occurred with a single
+  reversible move (see Marcel van Kervinck, "The Cuckoo Hashing Approach to
+  Detecting Upcoming Repetitions"). The table stores the key difference
+  pieces[c][p][s1] ^ pieces[c][p][s2] ^ side for every non-pawn piece that
+  can move between s1 and s2 on an empty board.
+ */
+struct Cuckoo {
+  static constexpr std::size_t size = 8192;
+
+  std::array<std::uint64_t, size> keys;
+  std::array<std::uint8_t, size> from;
+  std::array<std::uint8_t, size> to;
+
+  static constexpr std::size_t h1(std::uint64_t key) { return key & 0x1fff; }
+  static constexpr std::size_t h2(std::uint64_t key) {
+    return (key >> 16) & 0x1fff;
+  }
+};
+
+inline const Cuckoo cuckoo = []() {
+  Cuckoo table = {};
+
+  for (auto colour : {Colour::White, Colour::Black}) {
+    for (auto piece : get_all_pieces()) {
+      if (piece == Piece::Pawn)
+        continue;
+
+      for (int s1 = 0; s1 < 64; ++s1) {
+        const auto sq = static_cast<std::size_t>(s1);
+        uint64_t attacks = 0;
+        switch (piece) {
+        case Piece::Knight:
+          attacks = knight_attack_board[sq];
+          break;
+        case Piece::Bishop:
+          attacks = bishop_attacks(s1, 0);
+          break;
+        case Piece::Rook:
+          attacks = rook_attacks(s1, 0);
+          break;
+        case Piece::Queen:
+          attacks = bishop_attacks(s1, 0) | rook_attacks(s1, 0);
+          break;
+        case Piece::King:
+          attacks = king_attack_board[sq];
+          break;
+        default:
+          __builtin_unreachable();
+        }
+
+        for (int s2 = s1 + 1; s2 < 64; ++s2) {
+          if (not(attacks & (1UL << s2)))
+            continue;
+
+          auto key = piece_key(colour, piece, s1) ^
+                     piece_key(colour, piece, s2) ^ keys.side;
+          auto from = static_cast<std::uint8_t>(s1);
+          auto to = static_cast<std::uint8_t>(s2);
+
+          // Insert, displacing entries to their alternative slot as needed
+          auto slot = Cuckoo::h1(key);
+          while (true) {
+            std::swap(table.keys[slot], key);
+            std::swap(table.from[slot], from);
+            std::swap(table.to[slot], to);
+            if (key == 0)
+              break;
+            slot = (slot == Cuckoo::h1(key)) ? Cuckoo::h2(key)
+                                             : Cuckoo::h1(key);
+          }
+        }
+      }
+    }
+  }
+
+  return table;
+}();
+} // namespace mcc::zobrist
@@ -0,0 +1,127 @@
+#include "mcc/batch_analysis.hh"
+#include "mcc/mcc.hh"
+#include "mcc/search.hh"
+
+#include <catch2/catch.hpp>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+const std::vector<std::string> batch_positions = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1"};
+
+// Analyses the lines with the given number of threads, returns the output
+// lines
+std::vector<std::string> analyse(const std::vector<std::string> &lines,
+                                 unsigned int threads) {
+  std::stringstream in;
+  for (const auto &line : lines)
+    in << line << "\n";
+  std::stringstream out;
+  mcc::BatchOptions options;
+  options.threads = threads;
+  options.depth = 5;
+  options.hash_megabytes = 2 * threads;
+  mcc::analyse_batch(in, out, options);
+
+  std::vector<std::string> results;
+  for (std::string line; std::getline(out, line);)
+    results.push_back(line);
+  return results;
+}
+} // namespace
+
+TEST_CASE("Invalid positions are reported", "[batch]") {
+  const std::vector<std::string> invalid = {
+      "8/8/8/8/8/8/8/8 w - - 0 1",        // No kings
+      "4k3/8/8/8/8/8/8/4KK2 w - - 0 1",   // Two white kings
+      "4k3/8/8/8/8/8/8/P3K3 w - - 0 1",   // Pawn on rank 1
+      "4R1k1/8/8/8/8/8/8/4K3 w - - 0 1",  // Side not to move in check
+      "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR x - - 0 1",
+      "not a fen"};
+
+  std::vector<std::string> lines = {batch_positions[0]};
+  lines.insert(lines.end(), invalid.begin(), invalid.end());
+  const auto results = analyse(lines, 2);
+  REQUIRE(results.size() == lines.size());
+  REQUIRE(results[0].find("\"bestmove\"") != std::string::npos);
+  for (std::size_t i = 0; i < invalid.size(); ++i) {
+    INFO(invalid[i]);
+    REQUIRE(results[i + 1] == "{\"fen\": \"" + invalid[i] +
+                                  "\", \"error\": \"invalid position\"}");
+  }
+}
+
+TEST_CASE("Batch results do not depend on the number of threads", "[batch]") {
+  // Every position twice, so that workers reuse their (cleared) tables
+  std::vector<std::string> lines = batch_positions;
+  lines.insert(lines.end(), batch_positions.begin(), batch_positions.end());
+
+  const auto results = analyse(lines, 1);
+  REQUIRE(results.size() == lines.size());
+  for (std::size_t i = 0; i < batch_positions.size(); ++i)
+    REQUIRE(results[i] == results[i + batch_positions.size()]);
+  REQUIRE(analyse(lines, 3) == results);
+
+  // The same as searching with a fresh searcher (with the table size of a
+  // worker)
+  mcc::Searcher searcher({}, 2);
+  mcc::mcc board(batch_positions[1]);
+  const auto result = searcher.search(board, 5);
+  REQUIRE(results[1] == mcc::to_json(batch_positions[1], result));
+}
+
+TEST_CASE("Long inputs are written in order", "[batch]") {
+  // More positions than fit in the window of two workers
+  std::vector<std::string> lines;
+  while (lines.size() <= 3 * mcc::batch_window(2))
+    lines.insert(lines.end(), batch_positions.begin(), batch_positions.end());
+
+  const auto results = analyse(lines, 2);
+  REQUIRE(results.size() == lines.size());
+  for (std::size_t i = 0; i < lines.size(); ++i)
+    REQUIRE(results[i] == results[i % batch_positions.size()]);
+}
+
+TEST_CASE("All results share one schema", "[batch]") {
+  const std::string fen = batch_positions[0];
+  const mcc::mcc board(fen);
+  mcc::SearchResult result;
+  result.pv = {board.generate_moves().front()};
+  result.depth = 7;
+  result.nodes = 1000;
+  const auto move = result.pv.front().to_uci();
+  const auto expected = [&](const std::string &score, int depth,
+                            std::size_t nodes, bool book) {
+    return "{\"fen\": \"" + fen + "\", \"bestmove\": \"" + move +
+           "\", \"score\": " + score + ", \"depth\": " +
+           std::to_string(depth) + ", \"pv\": [\"" + move +
+           "\"], \"nodes\": " + std::to_string(nodes) +
+           ", \"book\": " + (book ? "true" : "false") + "}";
+  };
+
+  result.score = -25;
+  REQUIRE(mcc::to_json(fen, result) == expected("{\"cp\": -25}", 7, 1000,
+                                                false));
+  result.score = mcc::MATE_SCORE - 3;
+  REQUIRE(mcc::to_json(fen, result) == expected("{\"mate\": 2}", 7, 1000,
+                                                false));
+  result.score = -mcc::MATE_SCORE + 4;
+  REQUIRE(mcc::to_json(fen, result) == expected("{\"mate\": -2}", 7, 1000,
+                                                false));
+  result.score = mcc::TB_WIN_SCORE - 5;
+  REQUIRE(mcc::to_json(fen, result) ==
+          expected("{\"tb\": \"win\", \"plies\": 5}", 7, 1000, false));
+  result.score = -mcc::TB_WIN_SCORE + 2;
+  REQUIRE(mcc::to_json(fen, result) ==
+          expected("{\"tb\": \"loss\", \"plies\": 2}", 7, 1000, false));
+
+  mcc::SearchResult book_result;
+  book_result.pv = result.pv;
+  REQUIRE(mcc::to_json(fen, book_result, true) == expected("null", 0, 0, true));
+}
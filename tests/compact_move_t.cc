@@ -0,0 +1,102 @@
+#include "mcc/compact_move.hh"
+#include "mcc/mcc.hh"
+
+#include <catch2/catch.hpp>
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+using Kind = mcc::CompactMove::Kind;
+
+// Converts every legal move of `board` (and of the positions after it, down
+// to `depth` plies) and back, counting the kinds of the moves
+void check_round_trip(mcc::mcc &board, int depth,
+                      std::map<Kind, std::size_t> &kinds) {
+  for (const auto &move : board.generate_moves()) {
+    const auto compact = mcc::CompactMove::from_move(move, board);
+    INFO(move.to_uci());
+    REQUIRE(compact);
+    REQUIRE(compact.get_from() == static_cast<int>(move.get_from()));
+    REQUIRE(compact.get_to() == static_cast<int>(move.get_to()));
+    REQUIRE(compact.to_move(board) == move);
+    REQUIRE(mcc::CompactMove::from_raw(compact.get_raw()) == compact);
+    ++kinds[compact.get_kind()];
+
+    if (depth > 1) {
+      board.make_move(move);
+      check_round_trip(board, depth - 1, kinds);
+      board.unmake_move();
+    }
+  }
+}
+} // namespace
+
+TEST_CASE("Compact moves convert back to the same move", "[compact_move]") {
+  const std::vector<std::string> fens = {
+      // Kiwipete: castling, en passant after double pushes, promotions
+      "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+      // Position 4: promotions with and without captures
+      "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+      // En passant that is possible right away
+      "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+      // Quiet promotions and promotion captures for Black
+      "4k3/8/8/8/8/8/1p5p/R3K1N1 b - - 0 1"};
+
+  std::map<Kind, std::size_t> kinds;
+  for (const auto &fen : fens) {
+    INFO(fen);
+    mcc::mcc board(fen);
+    check_round_trip(board, 2, kinds);
+  }
+
+  // All kinds of moves have been checked
+  for (const auto kind :
+       {Kind::Quiet, Kind::DoublePawnPush, Kind::KingCastle, Kind::QueenCastle,
+        Kind::Capture, Kind::EnPassant, Kind::PromotionKnight,
+        Kind::PromotionBishop, Kind::PromotionRook, Kind::PromotionQueen,
+        Kind::PromotionCaptureKnight, Kind::PromotionCaptureBishop,
+        Kind::PromotionCaptureRook, Kind::PromotionCaptureQueen}) {
+    INFO("kind " << static_cast<int>(kind));
+    REQUIRE(kinds[kind] > 0);
+  }
+}
+
+TEST_CASE("Compact moves know their kind", "[compact_move]") {
+  const mcc::mcc board(
+      "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+  std::map<std::string, mcc::CompactMove> moves;
+  for (const auto &move : board.generate_moves())
+    moves[move.to_uci()] = mcc::CompactMove::from_move(move, board);
+
+  REQUIRE(moves.at("e1g1").get_kind() == Kind::KingCastle);
+  REQUIRE(moves.at("e1c1").get_kind() == Kind::QueenCastle);
+  REQUIRE(moves.at("e1g1").is_castling());
+  REQUIRE(moves.at("a2a4").get_kind() == Kind::DoublePawnPush);
+  REQUIRE(moves.at("e5f7").get_kind() == Kind::Capture);
+  REQUIRE(moves.at("e5f7").is_capture());
+  REQUIRE_FALSE(moves.at("e5f7").is_promotion());
+  REQUIRE(moves.at("a2a3").get_kind() == Kind::Quiet);
+  REQUIRE_FALSE(mcc::CompactMove{});
+
+  const mcc::mcc promotions("4k3/8/8/8/8/8/1p5p/R3K1N1 b - - 0 1");
+  std::map<std::string, mcc::CompactMove> promotion_moves;
+  for (const auto &move : promotions.generate_moves())
+    promotion_moves[move.to_uci()] =
+        mcc::CompactMove::from_move(move, promotions);
+  REQUIRE(promotion_moves.at("b2b1n").get_promotion_piece() ==
+          mcc::Piece::Knight);
+  REQUIRE(promotion_moves.at("b2a1q").get_kind() ==
+          Kind::PromotionCaptureQueen);
+  REQUIRE(promotion_moves.at("h2g1r").is_capture());
+  REQUIRE(promotion_moves.at("h2h1b").get_kind() == Kind::PromotionBishop);
+
+  const mcc::mcc en_passant(
+      "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3");
+  for (const auto &move : en_passant.generate_moves()) {
+    const auto compact = mcc::CompactMove::from_move(move, en_passant);
+    REQUIRE(compact.is_en_passant() == (move.to_uci() == "e5f6"));
+  }
+}
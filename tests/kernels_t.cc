@@ -0,0 +1,83 @@
+#include "mcc/common/helpers.hh"
+#include "mcc/cpu.hh"
+#include "mcc/eval.hh"
+#include "mcc/mcc.hh"
+
+#include <catch2/catch.hpp>
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+// Random occupancies with few, some and many occupied squares
+std::vector<std::uint64_t> sample_occupancies() {
+  std::mt19937_64 generator(2024);
+  std::vector<std::uint64_t> occupancies = {0, ~std::uint64_t{0}};
+  for (int i = 0; i < 300; ++i) {
+    const auto a = generator();
+    const auto b = generator();
+    const auto c = generator();
+    occupancies.insert(occupancies.end(), {a & b & c, a, a | b});
+  }
+  return occupancies;
+}
+} // namespace
+
+TEST_CASE("PEXT slider attacks match the generic attacks", "[kernels]") {
+  const auto occupancies = sample_occupancies();
+
+  // The dispatched functions, whichever kernel the CPU uses
+  for (int square = 0; square < 64; ++square) {
+    for (const auto occupied : occupancies) {
+      REQUIRE(mcc::rook_attacks(square, occupied) ==
+              mcc::rook_attacks_generic(square, occupied));
+      REQUIRE(mcc::bishop_attacks(square, occupied) ==
+              mcc::bishop_attacks_generic(square, occupied));
+    }
+  }
+
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (not __builtin_cpu_supports("bmi2")) {
+    WARN("The CPU does not support BMI2, the PEXT kernel is not tested");
+    return;
+  }
+
+  // The tables are built here, as slider_tables is empty with MCC_ISA set
+  const auto rook = mcc::make_slider_table<-8, 8, -1, 1>();
+  const auto bishop = mcc::make_slider_table<-9, -7, 7, 9>();
+  for (int square = 0; square < 64; ++square) {
+    INFO("square " << square);
+    for (const auto occupied : occupancies) {
+      REQUIRE(mcc::slider_attacks_pext(rook, square, occupied) ==
+              mcc::rook_attacks_generic(square, occupied));
+      REQUIRE(mcc::slider_attacks_pext(bishop, square, occupied) ==
+              mcc::bishop_attacks_generic(square, occupied));
+    }
+  }
+#endif
+}
+
+TEST_CASE("The evaluation kernels agree", "[kernels]") {
+  const std::vector<std::string> fens = {
+      "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+      "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R b KQkq - 0 1",
+      "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+      "4k3/8/4K3/4P3/8/8/8/8 b - - 0 1"};
+
+  for (const auto &fen : fens) {
+    INFO(fen);
+    const mcc::mcc board(fen);
+    const int generic =
+        mcc::detail::evaluate_generic(board, mcc::default_eval_params);
+    REQUIRE(mcc::evaluate(board) == generic);
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("popcnt"))
+      REQUIRE(mcc::detail::evaluate_popcnt(board, mcc::default_eval_params) ==
+              generic);
+#endif
+  }
+}
@@ -0,0 +1,97 @@
+#include "mcc/common/colour.hh"
+#include "mcc/eval.hh"
+#include "mcc/kpk.hh"
+#include "mcc/mcc.hh"
+
+#include <catch2/catch.hpp>
+
+#include <cctype>
+#include <string>
+
+namespace {
+// Mirrors the position of a FEN vertically and swaps the colours (the
+// position must have no castling rights and no en passant square)
+std::string flip_colours(const std::string &fen) {
+  const auto board_end = fen.find(' ');
+  std::string flipped;
+  for (auto rank_end = board_end; rank_end != std::string::npos;) {
+    const auto rank_start = fen.rfind('/', rank_end - 1);
+    const auto first = rank_start == std::string::npos ? 0 : rank_start + 1;
+    for (auto i = first; i < rank_end; ++i) {
+      const auto c = static_cast<unsigned char>(fen[i]);
+      flipped += static_cast<char>(std::isupper(c) ? std::tolower(c)
+                                                   : std::toupper(c));
+    }
+    if (rank_start == std::string::npos)
+      break;
+    flipped += '/';
+    rank_end = rank_start;
+  }
+  const bool white = fen[board_end + 1] == 'w';
+  return flipped + (white ? " b" : " w") + fen.substr(board_end + 2);
+}
+} // namespace
+
+TEST_CASE("The KPK bitbase knows won and drawn positions", "[kpk]") {
+  using mcc::Colour;
+  // Squares as on the board, a8 = 0 and h1 = 63. The king in front of its
+  // pawn on the sixth rank wins whoever is to move
+  REQUIRE(mcc::kpk::probe(Colour::White, 19, 27, 3));
+  REQUIRE(mcc::kpk::probe(Colour::Black, 19, 27, 3));
+  // Rook pawn with the defending king in the corner
+  REQUIRE_FALSE(mcc::kpk::probe(Colour::White, 16, 24, 0));
+  REQUIRE_FALSE(mcc::kpk::probe(Colour::Black, 16, 24, 0));
+  // Stalemate
+  REQUIRE_FALSE(mcc::kpk::probe(Colour::Black, 19, 11, 3));
+  // The pawn runs away from the king
+  REQUIRE(mcc::kpk::probe(Colour::White, 63, 48, 15));
+}
+
+TEST_CASE("King and pawn versus king is evaluated exactly", "[kpk]") {
+  struct Case {
+    std::string fen;
+    bool win;
+  };
+  const Case cases[] = {
+      // King in front of the pawn on the sixth rank
+      {"4k3/8/4K3/4P3/8/8/8/8 w - - 0 1", true},
+      {"4k3/8/4K3/4P3/8/8/8/8 b - - 0 1", true},
+      // Stalemate
+      {"4k3/4P3/4K3/8/8/8/8/8 b - - 0 1", false},
+      // Rook pawn, the defending king cannot be driven out of the corner
+      {"k7/8/K7/P7/8/8/8/8 w - - 0 1", false},
+      // The king is outside the square of the pawn
+      {"8/k7/8/8/8/8/7P/K7 w - - 0 1", true},
+      // Inside the square of the pawn
+      {"8/8/8/5k2/8/8/7P/K7 b - - 0 1", false}};
+
+  for (const auto &[fen, win] : cases) {
+    for (const auto &position : {fen, flip_colours(fen)}) {
+      INFO(position);
+      const mcc::mcc board(position);
+      const auto score =
+          mcc::detail::evaluate_kpk(board, mcc::default_eval_params);
+      REQUIRE(score);
+      REQUIRE(mcc::evaluate(board) == *score);
+      if (not win) {
+        REQUIRE(*score == 0);
+        continue;
+      }
+
+      // Positive for the side with the pawn
+      const auto pawns = board.get_bitboard(mcc::Piece::Pawn,
+                                            board.get_active_colour());
+      REQUIRE((pawns ? *score : -*score) > 0);
+    }
+  }
+}
+
+TEST_CASE("Other endings are not evaluated as KPK", "[kpk]") {
+  for (const auto &fen : {"4k3/8/4K3/4R3/8/8/8/8 w - - 0 1",
+                          "4k3/8/4K3/4PP2/8/8/8/8 w - - 0 1",
+                          "4k3/8/8/8/8/8/8/4K3 w - - 0 1"}) {
+    INFO(fen);
+    REQUIRE_FALSE(mcc::detail::evaluate_kpk(mcc::mcc(fen),
+                                            mcc::default_eval_params));
+  }
+}
@@ -0,0 +1,278 @@
+#include "mcc/batch_loader.hh"
+#include "mcc/mcc.hh"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+// Makes the moves given in UCI notation, which must be legal
+void play(mcc::mcc &board, const std::vector<std::string_view> &moves) {
+  for (const auto uci : moves) {
+    bool found = false;
+    for (const auto &move : board.generate_moves()) {
+      if (move.to_uci() == uci) {
+        board.make_move(move);
+        found = true;
+        break;
+      }
+    }
+    if (not found)
+      throw std::invalid_argument("Illegal move " + std::string(uci));
+  }
+}
+} // namespace
+
+TEST_CASE("Repetitions are counted", "[mcc]") {
+  mcc::mcc board;
+  REQUIRE_FALSE(board.is_repetition());
+
+  SECTION("Threefold repetition with a knight shuffle") {
+    play(board, {"g1f3", "b8c6", "f3g1", "c6b8"});
+    REQUIRE(board.is_repetition());
+    REQUIRE_FALSE(board.is_threefold());
+    REQUIRE_FALSE(board.is_game_drawn());
+    REQUIRE(board.count_repetitions(5) == 1);
+
+    play(board, {"g1f3", "b8c6", "f3g1"});
+    REQUIRE(board.is_repetition());
+    REQUIRE_FALSE(board.is_threefold());
+
+    play(board, {"c6b8"});
+    REQUIRE(board.is_threefold());
+    REQUIRE(board.is_game_drawn());
+    REQUIRE(board.count_repetitions(5) == 2);
+    REQUIRE(board.count_repetitions(1) == 1);
+  }
+
+  SECTION("Irreversible moves break repetitions") {
+    play(board, {"g1f3", "b8c6", "f3g1", "c6b8", "e2e3", "e7e6"});
+    REQUIRE_FALSE(board.is_repetition());
+
+    play(board, {"g1f3", "b8c6", "f3g1", "c6b8"});
+    REQUIRE(board.is_repetition());
+    REQUIRE_FALSE(board.is_threefold());
+
+    // Positions only differing in the side to move are not repetitions
+    play(board, {"g1f3", "b8c6", "f3g1", "c6b8", "d1e2", "d8e7", "e2d1"});
+    REQUIRE_FALSE(board.is_repetition());
+  }
+}
+
+TEST_CASE("Earlier repetitions in the game are found", "[mcc]") {
+  mcc::mcc board;
+  play(board, {"g1f3", "b8c6"});
+  REQUIRE_FALSE(board.has_repeated());
+
+  play(board, {"f3g1", "c6b8", "g1f3", "b8c6"});
+  REQUIRE(board.is_repetition());
+  REQUIRE(board.has_repeated());
+
+  // The current position is new, but the game repeated before
+  play(board, {"b1c3"});
+  REQUIRE_FALSE(board.is_repetition());
+  REQUIRE(board.has_repeated());
+
+  // Until an irreversible move is made
+  play(board, {"e7e5"});
+  REQUIRE_FALSE(board.has_repeated());
+}
+
+TEST_CASE("Upcoming repetitions are detected", "[mcc]") {
+  mcc::mcc board;
+
+  SECTION("A move back repeats a position in the search tree") {
+    play(board, {"g1f3", "b8c6", "f3g1"});
+    // Nb8 repeats the position three plies ago, if that is inside the tree
+    REQUIRE(board.has_upcoming_repetition(4));
+    REQUIRE_FALSE(board.has_upcoming_repetition(3));
+  }
+
+  SECTION("No single move repeats a position") {
+    play(board, {"g1f3", "g8f6", "b1c3", "b8c6"});
+    REQUIRE_FALSE(board.has_upcoming_repetition(10));
+  }
+
+  SECTION("The move back must not be blocked") {
+    // The rook goes a1-b1-b4-a4, Ra1 would repeat the first position
+    const std::vector<std::string_view> rook_tour = {
+        "h8g8", "a1b1", "g8f8", "b1b4", "f8g8", "b4a4", "g8h8"};
+    mcc::mcc open("7k/8/8/8/8/8/8/R3K1N1 b - - 0 1");
+    play(open, rook_tour);
+    REQUIRE(open.has_upcoming_repetition(10));
+
+    mcc::mcc blocked("7k/8/8/8/8/8/N7/R3K3 b - - 0 1");
+    play(blocked, rook_tour);
+    REQUIRE_FALSE(blocked.has_upcoming_repetition(10));
+  }
+
+  SECTION("Irreversible moves end the search for repetitions") {
+    play(board, {"g1f3", "b8c6", "e2e4"});
+    REQUIRE_FALSE(board.has_upcoming_repetition(10));
+  }
+}
+
+TEST_CASE("The fifty move rule ends the game unless it is mate", "[mcc]") {
+  mcc::mcc board("7k/8/6K1/8/8/8/8/R7 w - - 99 80");
+  REQUIRE_FALSE(board.is_fifty_move_draw());
+
+  SECTION("A quiet move on the 100th ply draws") {
+    play(board, {"a1b1"});
+    REQUIRE(board.get_half_moves() == 100);
+    REQUIRE(board.is_fifty_move_draw());
+    REQUIRE(board.is_game_drawn());
+  }
+
+  SECTION("Mate on the 100th ply wins") {
+    play(board, {"a1a8"});
+    REQUIRE(board.get_half_moves() == 100);
+    REQUIRE(board.in_check());
+    REQUIRE(board.generate_moves().empty());
+    REQUIRE_FALSE(board.is_fifty_move_draw());
+    REQUIRE_FALSE(board.is_game_drawn());
+  }
+
+  SECTION("Captures and pawn moves reset the counter") {
+    mcc::mcc pawns("7k/8/6K1/8/8/8/P7/8 w - - 99 80");
+    play(pawns, {"a2a3"});
+    REQUIRE(pawns.get_half_moves() == 0);
+    REQUIRE_FALSE(pawns.is_fifty_move_draw());
+  }
+}
+
+TEST_CASE("FEN strings are validated", "[mcc][fen]") {
+  mcc::mcc board;
+  const std::string start =
+      "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+  SECTION("Valid FEN and EPD strings") {
+    for (const auto *fen :
+         {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -",
+          "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1\r\n",
+          "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 5",
+          "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - bm e4;",
+          "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1 "
+          "bm e4; id \"start 1-0\";",
+          "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1",
+          "rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2"}) {
+      INFO(fen);
+      REQUIRE(board.load_from_fen(fen));
+    }
+  }
+
+  SECTION("Invalid FEN strings") {
+    for (const auto &fen : std::vector<std::string>{
+             "",
+             start + " junk",
+             start + " 1 2 3",
+             "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 5x 1",
+             "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1x",
+             "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 99999999 1",
+             "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - bm e4",
+             "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkx - 0 1",
+             "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBN w KQkq - 0 1",
+             "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNRR w KQkq - 0 1",
+             // The en passant square does not fit the side to move
+             "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq e3 0 1",
+             "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR w KQkq e3 0 1",
+             // No pawn was pushed past the en passant square
+             "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR b KQkq e3 0 1",
+             "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq e6 0 1",
+             "rnbqkbnr/pppp1ppp/4p3/8/8/8/PPPPPPPP/RNBQKBNR w KQkq e6 0 1",
+             // The square in front of the pushed pawn is occupied
+             "rnbqkbnr/pppppppp/8/4p3/8/8/PPPPPPPP/RNBQKBNR w KQkq e6 0 1",
+             // Kings, pawns on the back ranks and the side not to move in
+             // check
+             "8/8/8/8/8/8/8/8 w - - 0 1",
+             "4k3/8/8/8/8/8/8/4KK2 w - - 0 1",
+             "4k3/8/8/8/8/8/8/P3K3 w - - 0 1",
+             "4R1k1/8/8/8/8/8/8/4K3 w - - 0 1"}) {
+      INFO(fen);
+      REQUIRE_FALSE(board.load_from_fen(fen));
+    }
+  }
+
+  SECTION("Only legal en passant captures are generated") {
+    REQUIRE(board.load_from_fen(start));
+    REQUIRE(board.generate_moves().size() == 20);
+
+    REQUIRE(board.load_from_fen(
+        "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3"));
+    REQUIRE(board.get_en_passant_square() == 21);
+    std::vector<std::string> captures;
+    for (const auto &move : board.generate_moves())
+      if (move.is_capture())
+        captures.push_back(move.to_uci());
+    REQUIRE(captures == std::vector<std::string>{"e5f6"});
+  }
+
+  SECTION("Any subset of the castling rights is read") {
+    const auto castling_moves = [&](std::string_view fen) {
+      REQUIRE(board.load_from_fen(fen));
+      std::vector<std::string> moves;
+      for (const auto &move : board.generate_moves()) {
+        const auto uci = move.to_uci();
+        if (uci == "e1g1" || uci == "e1c1" || uci == "e8g8" || uci == "e8c8")
+          moves.push_back(uci);
+      }
+      std::sort(moves.begin(), moves.end());
+      return moves;
+    };
+    using Moves = std::vector<std::string>;
+    REQUIRE(castling_moves("r3k2r/8/8/8/8/8/8/R3K2R w Kq - 0 1") ==
+            Moves{"e1g1"});
+    REQUIRE(castling_moves("r3k2r/8/8/8/8/8/8/R3K2R b Kq - 0 1") ==
+            Moves{"e8c8"});
+    REQUIRE(castling_moves("r3k2r/8/8/8/8/8/8/R3K2R w Qk - 0 1") ==
+            Moves{"e1c1"});
+    REQUIRE(castling_moves("r3k2r/8/8/8/8/8/8/R3K2R b qK - 0 1") ==
+            Moves{"e8c8"});
+    REQUIRE(castling_moves("r3k2r/8/8/8/8/8/8/R3K2R w - - 0 1").empty());
+  }
+
+  SECTION("The move counters are optional") {
+    REQUIRE(board.load_from_fen(
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 12 40"));
+    REQUIRE(board.get_half_moves() == 12);
+    REQUIRE(board.load_from_fen(
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - bm e4;"));
+    REQUIRE(board.get_half_moves() == 0);
+  }
+}
+
+TEST_CASE("Position files are loaded in order", "[mcc][fen]") {
+  const auto path =
+      std::filesystem::temp_directory_path() / "mcc_test_positions.epd";
+  const std::vector<std::string> fens = {
+      "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+      "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+      "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - bm Rb1; id \"pos 3\";",
+      "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1"};
+
+  {
+    // Empty lines and Windows line endings are skipped
+    std::ofstream out(path, std::ios::binary);
+    for (std::size_t i = 0; i < 50; ++i)
+      out << fens[i % fens.size()] << (i % 7 == 0 ? "\r\n\n" : "\n");
+  }
+  for (const unsigned int threads : {1U, 3U}) {
+    const auto positions = mcc::load_positions(path, threads);
+    REQUIRE(positions.size() == 50);
+    for (std::size_t i = 0; i < positions.size(); ++i)
+      REQUIRE(positions[i].get_key() ==
+              mcc::mcc(fens[i % fens.size()]).get_key());
+  }
+
+  {
+    std::ofstream out(path, std::ios::binary);
+    out << fens[0] << "\n\n" << fens[1] << "\n" << fens[0] << " junk\n";
+  }
+  REQUIRE_THROWS_WITH(mcc::load_positions(path, 2),
+                      Catch::Contains("line 4 of"));
+}
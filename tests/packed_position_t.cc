@@ -0,0 +1,138 @@
+#include "mcc/mcc.hh"
+#include "mcc/packed_position.hh"
+#include "mcc/tuner.hh"
+
+#include <catch2/catch.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace {
+const std::vector<std::string> packed_fens = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r3k2r/8/8/8/8/8/8/R3K2R b Kq - 17 40",
+    "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+    "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 99 70"};
+
+// Replaces the code of the piece with the given index in the packed record
+void set_piece_code(mcc::PackedPosition &packed, std::size_t index,
+                    unsigned int code) {
+  auto &byte = packed.pieces[index / 2];
+  const auto shift = 4 * (index % 2);
+  byte = static_cast<std::uint8_t>((byte & ~(0xfU << shift)) |
+                                   (code << shift));
+}
+} // namespace
+
+TEST_CASE("Packed positions unpack to the same position", "[packed]") {
+  for (const auto &fen : packed_fens) {
+    INFO(fen);
+    const mcc::mcc board(fen);
+    const auto packed = mcc::PackedPosition::pack(board, 25,
+                                                  mcc::GameResult::Draw);
+    REQUIRE(packed.score == 25);
+    REQUIRE(packed.result == mcc::GameResult::Draw);
+
+    mcc::mcc unpacked;
+    REQUIRE(packed.unpack(unpacked));
+    REQUIRE(unpacked.get_key() == board.get_key());
+    REQUIRE(unpacked.get_occupied() == board.get_occupied());
+    REQUIRE(unpacked.get_en_passant_square() ==
+            board.get_en_passant_square());
+    REQUIRE(unpacked.get_half_moves() == board.get_half_moves());
+    REQUIRE(unpacked.generate_moves().size() ==
+            board.generate_moves().size());
+  }
+}
+
+TEST_CASE("Corrupt packed positions are rejected", "[packed]") {
+  const mcc::mcc board(packed_fens[0]);
+  const auto valid = mcc::PackedPosition::pack(board);
+  mcc::mcc unpacked;
+  REQUIRE(valid.unpack(unpacked));
+
+  auto packed = valid;
+  SECTION("Unknown piece codes") {
+    for (const unsigned int code : {6U, 7U, 14U, 15U}) {
+      set_piece_code(packed, 0, code);
+      REQUIRE_FALSE(packed.unpack(unpacked));
+    }
+  }
+
+  SECTION("Missing or extra kings") {
+    // The black king on e8 is the fifth piece, make it a queen or a king
+    // of the other colour
+    set_piece_code(packed, 4, 0x4);
+    REQUIRE_FALSE(packed.unpack(unpacked));
+    set_piece_code(packed, 4, 0x5);
+    REQUIRE_FALSE(packed.unpack(unpacked));
+  }
+
+  SECTION("More pieces than codes") {
+    packed.occupied |= 0xFFFFUL << 24;
+    REQUIRE_FALSE(packed.unpack(unpacked));
+  }
+
+  SECTION("Castling rights without king or rook") {
+    const auto no_rooks =
+        mcc::PackedPosition::pack(mcc::mcc("4k3/8/8/8/8/8/8/4K3 w - - 0 1"));
+    for (unsigned int right = 0; right < 4; ++right) {
+      packed = no_rooks;
+      packed.state = static_cast<std::uint16_t>(packed.state |
+                                                (1U << (right + 1)));
+      REQUIRE_FALSE(packed.unpack(unpacked));
+    }
+  }
+
+  SECTION("Invalid en passant files") {
+    packed.state = static_cast<std::uint16_t>(packed.state | (9U << 5));
+    REQUIRE_FALSE(packed.unpack(unpacked));
+    // No pawn was pushed to e5
+    packed = valid;
+    packed.state = static_cast<std::uint16_t>(packed.state | (5U << 5));
+    REQUIRE_FALSE(packed.unpack(unpacked));
+  }
+
+  SECTION("The side not to move is in check") {
+    packed = mcc::PackedPosition::pack(
+        mcc::mcc("4k3/8/8/8/8/8/8/R3K3 b - - 0 1"));
+    REQUIRE(packed.unpack(unpacked));
+    packed.state ^= 1;
+    REQUIRE(packed.unpack(unpacked));
+    packed = mcc::PackedPosition::pack(
+        mcc::mcc("4k3/8/8/8/8/8/8/4R1K1 b - - 0 1"));
+    packed.state ^= 1;
+    REQUIRE_FALSE(packed.unpack(unpacked));
+  }
+}
+
+TEST_CASE("Corrupt records in data sets are skipped", "[packed]") {
+  const auto path =
+      std::filesystem::temp_directory_path() / "mcc_test_positions.bin";
+  {
+    mcc::PackedPositionWriter writer(path);
+    for (const auto &fen : packed_fens)
+      writer.write(mcc::mcc(fen), 0, mcc::GameResult::WhiteWin);
+
+    auto corrupt = mcc::PackedPosition::pack(mcc::mcc(packed_fens[0]), 0,
+                                             mcc::GameResult::Draw);
+    set_piece_code(corrupt, 3, 7);
+    writer.write(corrupt);
+    auto bad_result =
+        mcc::PackedPosition::pack(mcc::mcc(packed_fens[0]), 0,
+                                  mcc::GameResult::Draw);
+    bad_result.result = static_cast<mcc::GameResult>(5);
+    writer.write(bad_result);
+  }
+
+  const mcc::PackedPositionReader reader(path);
+  REQUIRE(reader.size() == packed_fens.size() + 2);
+  const auto data = mcc::tuner::load_dataset(path, 2);
+  REQUIRE(data.size() == packed_fens.size());
+  REQUIRE(data.skipped == 2);
+}
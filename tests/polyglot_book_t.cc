@@ -0,0 +1,124 @@
+#include "mcc/mcc.hh"
+#include "mcc/polyglot_book.hh"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+// Writes the entries (which must be sorted by key) as a Polyglot book
+std::filesystem::path
+write_book(const std::string &name,
+           const std::vector<mcc::polyglot::Entry> &entries) {
+  const auto path = std::filesystem::temp_directory_path() / name;
+  std::ofstream out(path, std::ios::binary);
+  const auto write = [&out](std::uint64_t value, int bytes) {
+    for (int i = bytes - 1; i >= 0; --i)
+      out.put(static_cast<char>((value >> (8 * i)) & 0xFF));
+  };
+  for (const auto &entry : entries) {
+    write(entry.key, 8);
+    write(entry.move, 2);
+    write(entry.weight, 2);
+    write(entry.learn, 4);
+  }
+  return path;
+}
+
+// Polyglot encoding of a move given in coordinates (files and rows from 0)
+std::uint16_t book_move(int from_file, int from_row, int to_file, int to_row,
+                        int promotion = 0) {
+  return static_cast<std::uint16_t>(to_file | (to_row << 3) | (from_file << 6) |
+                                    (from_row << 9) | (promotion << 12));
+}
+} // namespace
+
+TEST_CASE("Polyglot keys match the reference keys", "[polyglot]") {
+  // The positions and keys from the Polyglot book format specification
+  const std::vector<std::pair<const char *, std::uint64_t>> positions = {
+      {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+       0x463b96181691fc9c},
+      {"rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1",
+       0x823c9b50fd114196},
+      {"rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2",
+       0x0756b94461c50fb0},
+      {"rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR b KQkq - 0 2",
+       0x662fafb965db29d4},
+      {"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+       0x22a48b5a8e47ff78},
+      {"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR b kq - 0 3",
+       0x652a607ca3f242c1},
+      {"rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 0 4",
+       0x00fdd303c946bdd9},
+      {"rnbqkbnr/p1pppppp/8/8/PpP4P/8/1P1PPPP1/RNBQKBNR b KQkq c3 0 3",
+       0x3c8123ea7b067637},
+      {"rnbqkbnr/p1pppppp/8/8/P6P/R1p5/1P1PPPP1/1NBQKBNR b Kkq - 0 4",
+       0x5c3f9b829b279560}};
+
+  for (const auto &[fen, key] : positions) {
+    INFO(fen);
+    REQUIRE(mcc::polyglot::compute_key(mcc::mcc(fen)) == key);
+  }
+}
+
+TEST_CASE("Polyglot books are probed by key", "[polyglot]") {
+  const mcc::mcc start;
+  const mcc::mcc castling("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1");
+  const auto start_key = mcc::polyglot::compute_key(start);
+  const auto castling_key = mcc::polyglot::compute_key(castling);
+
+  // e2e4 and d2d4 in the start position, plus an entry with a move that is
+  // illegal there (as after a key collision). White's castling moves are
+  // encoded as the king capturing its own rook.
+  std::vector<mcc::polyglot::Entry> entries = {
+      {start_key, book_move(4, 1, 4, 3), 3, 0},
+      {start_key, book_move(3, 1, 3, 3), 1, 0},
+      {start_key, book_move(4, 1, 4, 5), 5, 0},
+      {castling_key, book_move(4, 0, 7, 0), 1, 0},
+      {castling_key, book_move(4, 0, 0, 0), 1, 0}};
+  std::sort(entries.begin(), entries.end(),
+            [](const auto &a, const auto &b) { return a.key < b.key; });
+  const mcc::polyglot::Book book(write_book("mcc_test_book.bin", entries));
+  REQUIRE(book.size() == entries.size());
+
+  SECTION("Legal moves are found with their weights") {
+    const auto moves = book.probe(start);
+    REQUIRE(moves.size() == 2);
+    std::map<std::string, int> weights;
+    for (const auto &[move, weight] : moves)
+      weights[move.to_uci()] = weight;
+    REQUIRE(weights == std::map<std::string, int>{{"e2e4", 3}, {"d2d4", 1}});
+  }
+
+  SECTION("Castling moves are decoded") {
+    std::vector<std::string> moves;
+    for (const auto &[move, _] : book.probe(castling))
+      moves.push_back(move.to_uci());
+    std::sort(moves.begin(), moves.end());
+    REQUIRE(moves == std::vector<std::string>{"e1c1", "e1g1"});
+  }
+
+  SECTION("Positions that are not in the book give no move") {
+    const mcc::mcc board("4k3/8/8/8/8/8/8/4K3 w - - 0 1");
+    std::mt19937_64 generator(0);
+    REQUIRE(book.probe(board).empty());
+    REQUIRE_FALSE(book.pick(board, generator).has_value());
+  }
+
+  SECTION("Moves are picked in proportion to their weights") {
+    std::mt19937_64 generator(0);
+    std::map<std::string, int> counts;
+    for (int i = 0; i < 4000; ++i)
+      ++counts[book.pick(start, generator)->to_uci()];
+    REQUIRE(counts.size() == 2);
+    REQUIRE(counts["e2e4"] > 2700);
+    REQUIRE(counts["e2e4"] < 3300);
+  }
+}
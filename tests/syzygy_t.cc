@@ -0,0 +1,176 @@
+#include "mcc/eval.hh"
+#include "mcc/mcc.hh"
+#include "mcc/search.hh"
+#include "mcc/syzygy.hh"
+
+#include <catch2/catch.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+// Creates an empty directory for table files in the temporary directory
+std::filesystem::path make_table_directory(const std::string &name) {
+  const auto path = std::filesystem::temp_directory_path() / name;
+  std::filesystem::remove_all(path);
+  std::filesystem::create_directory(path);
+  return path;
+}
+} // namespace
+
+TEST_CASE("Missing tablebases are never probed", "[syzygy]") {
+  const auto directory = make_table_directory("mcc_test_syzygy_empty");
+  const mcc::syzygy::Tablebases tablebases(directory.string());
+  REQUIRE(tablebases.size() == 0);
+  REQUIRE(tablebases.get_max_pieces() == 0);
+
+  mcc::mcc board("4k3/8/8/8/8/8/8/R3K3 w - - 0 1");
+  auto state = mcc::syzygy::ProbeState::Ok;
+  tablebases.probe_wdl(board, state);
+  REQUIRE(state == mcc::syzygy::ProbeState::Fail);
+  REQUIRE(tablebases.filter_root_moves(board, true).empty());
+}
+
+TEST_CASE("Corrupt tables make probes fail", "[syzygy]") {
+  const auto directory = make_table_directory("mcc_test_syzygy_corrupt");
+  for (const auto *name : {"KRvK.rtbw", "KQvK.rtbw", "KRvK.rtbz",
+                           "KQQQQQQvK.rtbw", "notatable.rtbw"})
+    std::ofstream(directory / name) << "not a table";
+
+  const mcc::syzygy::Tablebases tablebases(directory.string());
+  // Only the valid table names with at most 7 pieces are registered
+  REQUIRE(tablebases.size() == 2);
+  REQUIRE(tablebases.get_max_pieces() == 3);
+
+  mcc::mcc board("4k3/8/8/8/8/8/8/R3K3 w - - 0 1");
+  auto state = mcc::syzygy::ProbeState::Ok;
+  tablebases.probe_wdl(board, state);
+  REQUIRE(state == mcc::syzygy::ProbeState::Fail);
+  tablebases.probe_dtz(board, state);
+  REQUIRE(state == mcc::syzygy::ProbeState::Fail);
+  REQUIRE(tablebases.filter_root_moves(board, true).empty());
+
+  // The search falls back to searching normally (only KvK positions, which
+  // need no table, are scored as tablebase draws)
+  mcc::Searcher searcher;
+  searcher.set_tablebases(&tablebases);
+  const auto result = searcher.search(board, 6);
+  REQUIRE(not result.pv.empty());
+  REQUIRE(result.score > 300);
+}
+
+TEST_CASE("Truncated tables make probes fail", "[syzygy]") {
+  // A KRvK WDL header with two plausible sub-tables, the index and the data
+  // are missing
+  const std::vector<std::uint8_t> sub_table = {
+      0, 5, 6, 0, 1, 0, 0, 0, 1, 1, 0, 0, 1, 0, 0, 0xF0, 0xFF, 0};
+  std::vector<std::uint8_t> file = {0x71, 0xE8, 0x23, 0x5D, 0x01,
+                                    0x00, 0x61, 0x16, 0x16, 0x00};
+  for (int side = 0; side < 2; ++side)
+    file.insert(file.end(), sub_table.begin(), sub_table.end());
+
+  const auto directory = make_table_directory("mcc_test_syzygy_truncated");
+  mcc::mcc board("4k3/8/8/8/8/8/8/R3K3 w - - 0 1");
+  for (std::size_t size = 0; size <= file.size(); ++size) {
+    INFO("size " << size);
+    std::ofstream(directory / "KRvK.rtbw", std::ios::binary)
+        .write(reinterpret_cast<const char *>(file.data()),
+               static_cast<std::streamsize>(size));
+
+    const mcc::syzygy::Tablebases tablebases(directory.string());
+    auto state = mcc::syzygy::ProbeState::Ok;
+    tablebases.probe_wdl(board, state);
+    REQUIRE(state == mcc::syzygy::ProbeState::Fail);
+  }
+}
+
+/* Probes real tables. Configure with -DMCC_SYZYGY_PATH=<dir> pointing to a
+   directory with (at least) the KPvK, KRvK and KQvK tables to enable these
+   tests. */
+#ifdef MCC_SYZYGY_PATH
+TEST_CASE("Tablebases score known positions", "[syzygy]") {
+  const mcc::syzygy::Tablebases tablebases(MCC_SYZYGY_PATH);
+  REQUIRE(tablebases.get_max_pieces() >= 3);
+
+  const auto wdl = [&](std::string_view fen) {
+    mcc::mcc board(fen);
+    auto state = mcc::syzygy::ProbeState::Ok;
+    const auto score = tablebases.probe_wdl(board, state);
+    REQUIRE(state != mcc::syzygy::ProbeState::Fail);
+    return score;
+  };
+
+  SECTION("WDL") {
+    REQUIRE(wdl("4k3/8/8/8/8/8/8/R3K3 w - - 0 1") == mcc::syzygy::Win);
+    REQUIRE(wdl("4k3/8/8/8/8/8/8/R3K3 b - - 0 1") == mcc::syzygy::Loss);
+    // Black captures the undefended rook
+    REQUIRE(wdl("8/8/8/8/8/8/6kR/K7 b - - 0 1") == mcc::syzygy::Draw);
+    // The table is stored for White as the stronger side
+    REQUIRE(wdl("3qk3/8/8/8/8/8/8/4K3 w - - 0 1") == mcc::syzygy::Loss);
+  }
+
+  SECTION("DTZ and root moves") {
+    // Rh8 mates
+    mcc::mcc board("k7/8/1K6/8/8/8/8/7R w - - 0 1");
+    auto state = mcc::syzygy::ProbeState::Ok;
+    const auto dtz = tablebases.probe_dtz(board, state);
+    REQUIRE(state != mcc::syzygy::ProbeState::Fail);
+    REQUIRE(dtz >= 1);
+    REQUIRE(dtz <= 2);
+
+    const auto moves = tablebases.filter_root_moves(board, true);
+    REQUIRE(moves.size() == 1);
+    REQUIRE(moves.front().to_uci() == "h1h8");
+
+    mcc::Searcher searcher;
+    searcher.set_tablebases(&tablebases);
+    const auto result = searcher.search(board, 4);
+    REQUIRE(result.pv.front().to_uci() == "h1h8");
+    REQUIRE(result.tb_hits >= 1);
+  }
+
+  SECTION("KPvK agrees with the bitbase") {
+    // Every legal KPvK position with the pawn on the e-file
+    for (int pawn_rank = 2; pawn_rank <= 7; ++pawn_rank) {
+      for (int white_king = 0; white_king < 64; ++white_king) {
+        for (int black_king = 0; black_king < 64; ++black_king) {
+          for (const char side : {'w', 'b'}) {
+            std::string squares(64, '1');
+            const auto pawn =
+                static_cast<std::size_t>(8 * (8 - pawn_rank) + 4);
+            if (static_cast<int>(pawn) == white_king ||
+                static_cast<int>(pawn) == black_king ||
+                white_king == black_king)
+              continue;
+            squares[pawn] = 'P';
+            squares[static_cast<std::size_t>(white_king)] = 'K';
+            squares[static_cast<std::size_t>(black_king)] = 'k';
+
+            std::string fen;
+            for (std::size_t rank = 0; rank < 8; ++rank)
+              fen += squares.substr(8 * rank, 8) + (rank < 7 ? "/" : " ");
+            fen += std::string(1, side) + " - - 0 1";
+
+            // The bitbase does not know about mate and stalemate
+            mcc::mcc board;
+            if (not board.load_from_fen(fen) || board.generate_moves().empty())
+              continue;
+
+            INFO(fen);
+            auto state = mcc::syzygy::ProbeState::Ok;
+            const auto score = tablebases.probe_wdl(board, state);
+            REQUIRE(state != mcc::syzygy::ProbeState::Fail);
+            const bool white_wins = side == 'w' ? score == mcc::syzygy::Win
+                                                : score == mcc::syzygy::Loss;
+            REQUIRE(white_wins == (mcc::evaluate(board) != 0));
+          }
+        }
+      }
+    }
+  }
+}
+#endif
@@ -0,0 +1,96 @@
+#include "mcc/eval.hh"
+#include "mcc/mcc.hh"
+#include "mcc/tuner.hh"
+
+#include <catch2/catch.hpp>
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+namespace {
+const std::vector<const char *> sample_positions = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R b KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1",
+    "6k1/5ppp/8/8/8/8/q4PPP/1R4K1 b - - 0 30"};
+} // namespace
+
+TEST_CASE("Results are only read from the result fields", "[tuner]") {
+  using mcc::tuner::parse_result;
+  const auto fen = std::string(sample_positions[0]);
+
+  REQUIRE(parse_result(fen + " [1.0]") == 1.0f);
+  REQUIRE(parse_result(fen + " [0.5]  ") == 0.5f);
+  REQUIRE(parse_result(fen + " [0]") == 0.0f);
+  REQUIRE(parse_result(fen + " [1-0]") == 1.0f);
+  REQUIRE(parse_result(fen + " c9 \"1/2-1/2\";") == 0.5f);
+  REQUIRE(parse_result(fen + " id \"x\"; c9 \"0-1\";") == 0.0f);
+  REQUIRE(parse_result(fen + " result \"1-0\";") == 1.0f);
+
+  // Results in other operands, or unknown results, are ignored
+  REQUIRE(parse_result(fen + " id \"Test 10-1\";") == std::nullopt);
+  REQUIRE(parse_result(fen + " id \"Game 0-1 [1]\";") == std::nullopt);
+  REQUIRE(parse_result(fen + " id \"c9\";") == std::nullopt);
+  REQUIRE(parse_result(fen + " xc9 \"1-0\";") == std::nullopt);
+  REQUIRE(parse_result(fen + " [2.0]") == std::nullopt);
+  REQUIRE(parse_result(fen) == std::nullopt);
+}
+
+TEST_CASE("The data set evaluation matches the engine", "[tuner]") {
+  mcc::tuner::Dataset data;
+  std::vector<int> expected;
+  for (const auto *fen : sample_positions) {
+    const mcc::mcc board(fen);
+    data.add(board, 0.5f);
+    const int eval = mcc::evaluate(board);
+    expected.push_back(board.get_active_colour() == mcc::Colour::White ? eval
+                                                                       : -eval);
+  }
+  REQUIRE(data.size() == sample_positions.size());
+
+  const auto params = mcc::tuner::to_vector(mcc::default_eval_params);
+  const auto weights = mcc::tuner::detail::feature_weights(params);
+  for (std::size_t i = 0; i < data.size(); ++i) {
+    INFO(sample_positions[i]);
+    REQUIRE(mcc::tuner::detail::evaluate(data, i, weights) ==
+            Approx(expected[i]));
+  }
+
+  // King and pawn versus king is scored by the bitbase and skipped
+  data.add(mcc::mcc("8/8/8/4k3/8/8/4P3/4K3 w - - 0 1"), 1.0f);
+  REQUIRE(data.size() == sample_positions.size());
+  REQUIRE(data.skipped == 1);
+}
+
+TEST_CASE("The gradient matches finite differences", "[tuner]") {
+  mcc::tuner::Dataset data;
+  for (std::size_t i = 0; i < sample_positions.size(); ++i)
+    data.add(mcc::mcc(sample_positions[i]), static_cast<float>(i % 3) / 2.0f);
+
+  auto params = mcc::tuner::to_vector(mcc::default_eval_params);
+  constexpr double k = 1.0;
+  std::vector<double> gradient;
+  mcc::tuner::compute_loss(data, params, k, 2, &gradient);
+  REQUIRE(gradient.size() == mcc::tuner::num_params);
+
+  // A few piece-square values of occupied squares and all material values
+  for (const std::size_t i :
+       {std::size_t{0} * 64 + 52, std::size_t{2} * 64 + 57,
+        std::size_t{5} * 64 + 60, mcc::tuner::num_pst_params,
+        mcc::tuner::num_pst_params + 1, mcc::tuner::num_pst_params + 4}) {
+    constexpr double h = 1e-3;
+    const double original = params[i];
+    params[i] = original + h;
+    const double loss_plus = mcc::tuner::compute_loss(data, params, k, 1);
+    params[i] = original - h;
+    const double loss_minus = mcc::tuner::compute_loss(data, params, k, 1);
+    params[i] = original;
+
+    INFO("parameter " << i);
+    REQUIRE(gradient[i] ==
+            Approx((loss_plus - loss_minus) / (2 * h)).margin(1e-9));
+  }
+}